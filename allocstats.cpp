@@ -0,0 +1,139 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#include"allocstats.hpp"
+#include<SDL.h>
+#include<atomic>
+#include<cstdlib>
+#include<new>
+
+namespace {
+
+std::atomic<size_t> allocations{0};
+
+SDL_malloc_func sdl_malloc;
+SDL_calloc_func sdl_calloc;
+SDL_realloc_func sdl_realloc;
+SDL_free_func sdl_free;
+
+void* counting_malloc(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return sdl_malloc(size);
+}
+
+void* counting_calloc(size_t nmemb, size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return sdl_calloc(nmemb, size);
+}
+
+void* counting_realloc(void *mem, size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return sdl_realloc(mem, size);
+}
+
+void* counted_new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void *p = std::malloc(size ? size : 1);
+    if(!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* counted_new(size_t size, std::align_val_t align) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    const size_t a = size_t(align);
+#if defined(_MSC_VER)
+    void *p = _aligned_malloc(size ? size : 1, a);
+#else
+    // aligned_alloc wants the size to be a multiple of the alignment.
+    void *p = std::aligned_alloc(a, (size + a - 1)/a*a);
+#endif
+    if(!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void aligned_free(void *p) {
+#if defined(_MSC_VER)
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+}
+
+size_t heap_allocations() {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+void count_sdl_allocations() {
+    SDL_GetOriginalMemoryFunctions(&sdl_malloc, &sdl_calloc, &sdl_realloc, &sdl_free);
+    SDL_SetMemoryFunctions(counting_malloc, counting_calloc, counting_realloc, sdl_free);
+}
+
+void* operator new(size_t size) {
+    return counted_new(size);
+}
+
+void* operator new[](size_t size) {
+    return counted_new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t &) noexcept {
+    try {
+        return counted_new(size);
+    } catch(const std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, const std::nothrow_t &) noexcept {
+    try {
+        return counted_new(size);
+    } catch(const std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+void* operator new(size_t size, std::align_val_t align) {
+    return counted_new(size, align);
+}
+
+void* operator new[](size_t size, std::align_val_t align) {
+    return counted_new(size, align);
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept {
+    aligned_free(p);
+}
+
+void operator delete[](void *p, std::align_val_t) noexcept {
+    aligned_free(p);
+}
+
+void operator delete(void *p, size_t, std::align_val_t) noexcept {
+    aligned_free(p);
+}
+
+void operator delete[](void *p, size_t, std::align_val_t) noexcept {
+    aligned_free(p);
+}
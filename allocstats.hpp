@@ -0,0 +1,15 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include<cstddef>
+
+// Number of heap allocations made so far on any thread through
+// operator new or, once counting is enabled, SDL_malloc and friends.
+// Other C libraries allocate behind its back.
+size_t heap_allocations();
+
+// Routes SDL's allocations through the counter. Must be called before
+// SDL allocates anything, that is before SDL_Init.
+void count_sdl_allocations();
@@ -0,0 +1,301 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#include"assetpack.hpp"
+#include"compressedtex.hpp"
+#include"loader.hpp"
+#include<algorithm>
+#include<cstdio>
+#include<cassert>
+#include<cstring>
+
+#ifdef _WIN32
+#include<windows.h>
+#else
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<unistd.h>
+#endif
+
+namespace {
+
+const void* map_file(const char *fname, size_t &size, void **file_handle, void **map_handle) {
+#ifdef _WIN32
+    HANDLE f = CreateFileA(fname, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(f == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+    LARGE_INTEGER s;
+    if(!GetFileSizeEx(f, &s) || s.QuadPart == 0) {
+        CloseHandle(f);
+        return nullptr;
+    }
+    HANDLE m = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(!m) {
+        CloseHandle(f);
+        return nullptr;
+    }
+    const void *p = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+    if(!p) {
+        CloseHandle(m);
+        CloseHandle(f);
+        return nullptr;
+    }
+    size = size_t(s.QuadPart);
+    *file_handle = f;
+    *map_handle = m;
+    return p;
+#else
+    (void)file_handle;
+    (void)map_handle;
+    int fd = open(fname, O_RDONLY);
+    if(fd < 0) {
+        return nullptr;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return nullptr;
+    }
+    void *p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after the descriptor is closed.
+    close(fd);
+    if(p == MAP_FAILED) {
+        return nullptr;
+    }
+    size = size_t(st.st_size);
+    return p;
+#endif
+}
+
+}
+
+asset_pack::~asset_pack() {
+    unload();
+}
+
+bool asset_pack::load(const char *fname) {
+    unload();
+#ifdef _WIN32
+    mapping = static_cast<const Uint8*>(map_file(fname, mapping_size, &file_handle, &map_handle));
+#else
+    mapping = static_cast<const Uint8*>(map_file(fname, mapping_size, nullptr, nullptr));
+#endif
+    if(!mapping) {
+        printf("Could not map asset pack %s.\n", fname);
+        return false;
+    }
+    pack_header h;
+    if(mapping_size < sizeof(h)) {
+        printf("Asset pack %s is truncated.\n", fname);
+        unload();
+        return false;
+    }
+    memcpy(&h, mapping, sizeof(h));
+    if(memcmp(h.magic, pack_magic, sizeof(pack_magic)) != 0 ||
+            h.version != pack_version ||
+            h.byte_order != pack_byte_order_mark) {
+        printf("%s is not a compatible asset pack.\n", fname);
+        unload();
+        return false;
+    }
+    if(h.num_entries > (mapping_size - sizeof(h))/sizeof(pack_entry)) {
+        printf("Asset pack %s is truncated.\n", fname);
+        unload();
+        return false;
+    }
+    entries = reinterpret_cast<const pack_entry*>(mapping + sizeof(h));
+    num_entries = h.num_entries;
+    for(uint32_t i=0; i<num_entries; ++i) {
+        // Written so that a bogus offset or size can not wrap around.
+        if(entries[i].offset > mapping_size || entries[i].size > mapping_size - entries[i].offset) {
+            printf("Asset pack %s has an entry past its end.\n", fname);
+            unload();
+            return false;
+        }
+    }
+    if(!valid_layout()) {
+        printf("Asset pack %s has malformed pages or sprites.\n", fname);
+        unload();
+        return false;
+    }
+    int freq;
+    Uint16 format;
+    int channels;
+    if(!Mix_QuerySpec(&freq, &format, &channels) ||
+            freq != h.audio_freq || format != h.audio_format || channels != h.audio_channels) {
+        printf("Asset pack %s audio format does not match the mixer.\n", fname);
+        unload();
+        return false;
+    }
+    for(uint32_t i=0; i<num_entries; ++i) {
+        if(entries[i].type != PACK_SOUND) {
+            continue;
+        }
+        // SDL_mixer only reads from the buffer, it is safe to point it
+        // at read only memory.
+        chunks.push_back(Mix_QuickLoad_RAW(const_cast<Uint8*>(data(entries[i])), Uint32(entries[i].size)));
+    }
+    return true;
+}
+
+void asset_pack::unload() {
+    for(auto *c : chunks) {
+        Mix_FreeChunk(c);
+    }
+    chunks.clear();
+    if(mapping) {
+#ifdef _WIN32
+        UnmapViewOfFile(mapping);
+        CloseHandle(map_handle);
+        CloseHandle(file_handle);
+        map_handle = nullptr;
+        file_handle = nullptr;
+#else
+        munmap(const_cast<Uint8*>(mapping), mapping_size);
+#endif
+    }
+    mapping = nullptr;
+    mapping_size = 0;
+    entries = nullptr;
+    num_entries = 0;
+}
+
+// Everything that is later used without checks. Page and sprite
+// entries must describe memory within their blobs and pages.
+bool asset_pack::valid_layout() const {
+    std::vector<SDL_Point> pages;
+    for(uint32_t i=0; i<num_entries; ++i) {
+        const auto &e = entries[i];
+        if(e.type != PACK_PAGE) {
+            continue;
+        }
+        const int bpp = SDL_BYTESPERPIXEL(e.format_or_page);
+        if(bpp == 0 || SDL_ISPIXELFORMAT_FOURCC(e.format_or_page) || e.w <= 0 || e.h <= 0 ||
+                e.pitch/bpp < e.w || uint64_t(e.pitch)*uint64_t(e.h) > e.size) {
+            return false;
+        }
+        pages.push_back(SDL_Point{e.w, e.h});
+    }
+    for(uint32_t i=0; i<num_entries; ++i) {
+        const auto &e = entries[i];
+        if(e.type == PACK_SOUND && e.size > UINT32_MAX) {
+            return false;
+        }
+        if(e.type != PACK_SPRITE) {
+            continue;
+        }
+        if(e.format_or_page >= pages.size()) {
+            return false;
+        }
+        const auto &p = pages[e.format_or_page];
+        if(e.x < 0 || e.y < 0 || e.w <= 0 || e.h <= 0 || e.w > p.x - e.x || e.h > p.y - e.y) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const pack_entry* asset_pack::find(const char *name, pack_entry_type type) const {
+    for(uint32_t i=0; i<num_entries; ++i) {
+        if(entries[i].type == type && strncmp(entries[i].name, name, sizeof(entries[i].name)) == 0) {
+            return entries + i;
+        }
+    }
+    return nullptr;
+}
+
+std::vector<atlas_page_pixels> asset_pack::page_pixels() const {
+    std::vector<atlas_page_pixels> pages;
+    for(uint32_t i=0; i<num_entries; ++i) {
+        const auto &e = entries[i];
+        if(e.type == PACK_PAGE) {
+            pages.push_back(atlas_page_pixels{e.format_or_page, e.w, e.h, e.pitch, data(e)});
+        }
+    }
+    for(uint32_t i=0; i<num_entries; ++i) {
+        const auto &e = entries[i];
+        if(e.type == PACK_PAGE_BC3 && e.page < pages.size() &&
+                e.w == pages[e.page].w && e.h == pages[e.page].h && e.size == bc3_size(e.w, e.h)) {
+            pages[e.page].bc3 = data(e);
+        }
+    }
+    return pages;
+}
+
+bool asset_pack::contains(const std::vector<const char*> &sprites,
+        const std::vector<const char*> &sounds) const {
+    bool found = true;
+    for(const auto *n : sprites) {
+        if(!find(n, PACK_SPRITE)) {
+            printf("Sprite %s is not in the asset pack.\n", n);
+            found = false;
+        }
+    }
+    for(const auto *n : sounds) {
+        if(!find(n, PACK_SOUND) && !find(n, PACK_STREAM)) {
+            printf("Sound %s is not in the asset pack.\n", n);
+            found = false;
+        }
+    }
+    return found;
+}
+
+bool asset_pack::up_to_date(const std::vector<const char*> &sprites,
+        const std::vector<const char*> &sounds) const {
+    bool current = true;
+    auto check = [&current](const pack_entry *e, const char *name) {
+        // A pack can be used without its sources.
+        SDL_RWops *f = e ? SDL_RWFromFile(name, "rb") : nullptr;
+        if(!f) {
+            return;
+        }
+        std::vector<Uint8> bytes(size_t(std::max(SDL_RWsize(f), Sint64(0))));
+        bool same = bytes.size() == e->source_size &&
+                SDL_RWread(f, bytes.data(), 1, bytes.size()) == bytes.size() &&
+                content_hash(bytes.data(), bytes.size()) == e->source_hash;
+        SDL_RWclose(f);
+        if(!same) {
+            printf("%s has changed since the asset pack was built.\n", name);
+            current = false;
+        }
+    };
+    for(const auto *n : sprites) {
+        check(find(n, PACK_SPRITE), n);
+    }
+    for(const auto *n : sounds) {
+        const auto *e = find(n, PACK_SOUND);
+        check(e ? e : find(n, PACK_STREAM), n);
+    }
+    return current;
+}
+
+atlas_layout asset_pack::sprite_layout(const std::vector<const char*> &names) const {
+    atlas_layout layout;
+    for(const auto *n : names) {
+        const auto *e = find(n, PACK_SPRITE);
+        assert(e);
+        layout.page_of.push_back(int(e->format_or_page));
+        layout.rects.push_back(SDL_Rect{e->x, e->y, e->w, e->h});
+    }
+    return layout;
+}
+
+sound_asset asset_pack::sound(const char *name) const {
+    if(const auto *e = find(name, PACK_STREAM)) {
+        return sound_asset{nullptr, encoded_sound{data(*e), size_t(e->size)}};
+    }
+    size_t chunk_index = 0;
+    for(uint32_t i=0; i<num_entries; ++i) {
+        if(entries[i].type != PACK_SOUND) {
+            continue;
+        }
+        if(strncmp(entries[i].name, name, sizeof(entries[i].name)) == 0) {
+            return sound_asset{chunks[chunk_index], encoded_sound{nullptr, 0}};
+        }
+        ++chunk_index;
+    }
+    return sound_asset{nullptr, encoded_sound{nullptr, 0}};
+}
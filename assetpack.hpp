@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include<SDL.h>
+#include<SDL_mixer.h>
+#include"atlas.hpp"
+#include"soundstream.hpp"
+#include<cstdint>
+#include<vector>
+
+// An asset pack holds atlas pages as raw pixels, optionally with BC3
+// compressed copies, and sounds as PCM in the mixer's output format,
+// except long sounds which are kept as Ogg Vorbis for streaming. It is
+// produced at build time by mkpack and memory mapped at runtime so
+// nothing needs to be decoded.
+//
+// The file is a pack_header, followed by num_entries pack_entry
+// structs, followed by the data blobs. Blobs are aligned to
+// pack_alignment bytes. Everything is in native byte order. Sprites
+// and sounds remember the size and content_hash of their source file,
+// so that a pack older than the files can be told apart.
+
+const char pack_magic[8] = {'S', 'D', 'L', 'T', 'P', 'A', 'K', '1'};
+const uint32_t pack_version = 2;
+const uint32_t pack_byte_order_mark = 0x01020304;
+const uint64_t pack_alignment = 64;
+
+enum pack_entry_type : uint32_t {
+    PACK_PAGE = 1,
+    PACK_SPRITE = 2,
+    PACK_SOUND = 3,
+    PACK_STREAM = 4,
+    // A page compressed for GPUs that can sample it directly.
+    PACK_PAGE_BC3 = 5,
+};
+
+struct pack_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t num_entries;
+    int32_t audio_freq;
+    uint16_t audio_format;
+    uint16_t audio_channels;
+    uint32_t reserved;
+};
+
+struct pack_entry {
+    // Path of the source file relative to the source root. Empty for pages.
+    char name[64];
+    uint32_t type;
+    // Pages: pixel format. Sprites: index of the page they are on.
+    uint32_t format_or_page;
+    int32_t x;
+    int32_t y;
+    int32_t w;
+    int32_t h;
+    int32_t pitch;
+    // Compressed pages: index of the page they are a version of.
+    uint32_t page;
+    uint64_t offset;
+    uint64_t size;
+    // Sprites and sounds: the file they were made from.
+    uint64_t source_size;
+    uint64_t source_hash;
+};
+
+struct asset_pack {
+    asset_pack() = default;
+    ~asset_pack();
+
+    asset_pack(const asset_pack &) = delete;
+    asset_pack& operator=(const asset_pack &) = delete;
+
+    // Maps the file and validates it against the currently open mixer
+    // format. Prints the reason and returns false on failure.
+    bool load(const char *fname);
+    void unload();
+
+    // Whether every named asset is in the pack. Prints the missing ones.
+    bool contains(const std::vector<const char*> &sprites,
+            const std::vector<const char*> &sounds) const;
+    // Whether none of the named source files that can be found differs
+    // from what the pack was built from. Prints the changed ones.
+    bool up_to_date(const std::vector<const char*> &sprites,
+            const std::vector<const char*> &sounds) const;
+
+    std::vector<atlas_page_pixels> page_pixels() const;
+    // Location of the given sprites in the order they were asked for.
+    atlas_layout sprite_layout(const std::vector<const char*> &names) const;
+    // Plays or streams straight from the mapping. Chunks are owned by the pack.
+    sound_asset sound(const char *name) const;
+
+    const pack_entry* find(const char *name, pack_entry_type type) const;
+
+private:
+    bool valid_layout() const;
+    const Uint8* data(const pack_entry &e) const { return mapping + e.offset; }
+
+    const Uint8 *mapping = nullptr;
+    size_t mapping_size = 0;
+    const pack_entry *entries = nullptr;
+    uint32_t num_entries = 0;
+    std::vector<Mix_Chunk*> chunks;
+#ifdef _WIN32
+    void *file_handle = nullptr;
+    void *map_handle = nullptr;
+#endif
+};
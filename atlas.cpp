@@ -0,0 +1,278 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#include"atlas.hpp"
+#include"compressedtex.hpp"
+#include<algorithm>
+#include<numeric>
+#include<cmath>
+#include<cstdio>
+#include<cstdlib>
+
+namespace {
+
+const int atlas_padding = 1;
+
+int next_pow2(int v) {
+    int r = 1;
+    while(r < v) {
+        r *= 2;
+    }
+    return r;
+}
+
+int renderer_max_size(SDL_Renderer *rend) {
+    SDL_RendererInfo info;
+    int max_size = atlas_max_size;
+    if(SDL_GetRendererInfo(rend, &info) == 0 && info.max_texture_width > 0 && info.max_texture_height > 0) {
+        max_size = std::min({max_size, info.max_texture_width, info.max_texture_height});
+    }
+    return max_size;
+}
+
+// Places as many rectangles from order on one page as fit. The ones
+// that were placed are removed from order.
+void fill_page(const std::vector<SDL_Point> &sizes,
+        std::vector<size_t> &order,
+        int page_w,
+        int page_h,
+        int padding,
+        int page_index,
+        atlas_layout &layout,
+        int &used_w,
+        int &used_h) {
+    int x = 0;
+    int y = 0;
+    int shelf_h = 0;
+    used_w = 0;
+    used_h = 0;
+    std::vector<size_t> leftover;
+    for(const auto i : order) {
+        const int w = sizes[i].x + padding;
+        const int h = sizes[i].y + padding;
+        if(x + w > page_w) {
+            x = 0;
+            y += shelf_h;
+            shelf_h = 0;
+        }
+        if(w > page_w || y + h > page_h) {
+            leftover.push_back(i);
+            continue;
+        }
+        layout.page_of[i] = page_index;
+        layout.rects[i] = SDL_Rect{x, y, sizes[i].x, sizes[i].y};
+        x += w;
+        shelf_h = std::max(shelf_h, h);
+        used_w = std::max(used_w, x);
+        used_h = std::max(used_h, y + shelf_h);
+    }
+    order = std::move(leftover);
+}
+
+}
+
+atlas_layout pack_rects(const std::vector<SDL_Point> &sizes, int max_size, int padding) {
+    atlas_layout layout;
+    layout.page_of.resize(sizes.size(), -1);
+    layout.rects.resize(sizes.size(), SDL_Rect{0, 0, 0, 0});
+    std::vector<size_t> order(sizes.size());
+    std::iota(order.begin(), order.end(), 0);
+    // Tallest first keeps shelves tight.
+    std::stable_sort(order.begin(), order.end(), [&sizes](size_t a, size_t b) {
+        return sizes[a].y > sizes[b].y;
+    });
+    while(!order.empty()) {
+        int area = 0;
+        int widest = 0;
+        for(const auto i : order) {
+            area += (sizes[i].x + padding)*(sizes[i].y + padding);
+            widest = std::max(widest, sizes[i].x + padding);
+        }
+        if(widest > max_size) {
+            printf("Image of width %d does not fit in an atlas page of %d.\n", widest, max_size);
+            std::abort();
+        }
+        // Try the smallest square page that could hold everything that
+        // is left and grow until it fits or hits the size limit.
+        int side = std::min(max_size, next_pow2(std::max(widest, int(std::ceil(std::sqrt(double(area)))))));
+        while(true) {
+            atlas_layout trial = layout;
+            auto remaining = order;
+            int used_w, used_h;
+            fill_page(sizes, remaining, side, side, padding, int(layout.pages.size()), trial, used_w, used_h);
+            if(remaining.empty() || side >= max_size) {
+                if(remaining.size() == order.size()) {
+                    printf("Atlas packing made no progress.\n");
+                    std::abort();
+                }
+                trial.pages.push_back(atlas_layout::page{next_pow2(used_w), next_pow2(used_h)});
+                layout = std::move(trial);
+                order = std::move(remaining);
+                break;
+            }
+            side *= 2;
+        }
+    }
+    return layout;
+}
+
+std::vector<SDL_Surface*> compose_pages(const std::vector<SDL_Surface*> &images,
+        int max_size,
+        Uint32 format,
+        atlas_layout &layout) {
+    std::vector<SDL_Point> sizes;
+    sizes.reserve(images.size());
+    for(const auto *s : images) {
+        sizes.push_back(SDL_Point{s->w, s->h});
+    }
+    layout = pack_rects(sizes, max_size, atlas_padding);
+    std::vector<SDL_Surface*> surfaces;
+    for(const auto &p : layout.pages) {
+        SDL_Surface *page = SDL_CreateRGBSurfaceWithFormat(0, p.w, p.h, SDL_BITSPERPIXEL(format), format);
+        if(!page) {
+            printf("Atlas page creation failed: %s\n", SDL_GetError());
+            std::abort();
+        }
+        SDL_FillRect(page, nullptr, 0);
+        const int page_index = int(surfaces.size());
+        for(size_t i=0; i<images.size(); ++i) {
+            if(layout.page_of[i] != page_index) {
+                continue;
+            }
+            SDL_Rect dst = layout.rects[i];
+            SDL_SetSurfaceBlendMode(images[i], SDL_BLENDMODE_NONE);
+            SDL_BlitSurface(images[i], nullptr, page, &dst);
+        }
+        surfaces.push_back(page);
+    }
+    return surfaces;
+}
+
+page_allocator::page_allocator(int w_, int h_) : w(w_), h(h_) {
+}
+
+bool page_allocator::allocate(int img_w, int img_h, SDL_Rect &slot) {
+    const int sw = img_w + atlas_padding;
+    const int sh = img_h + atlas_padding;
+    // The smallest released slot that is big enough.
+    size_t best = free_slots.size();
+    for(size_t i=0; i<free_slots.size(); ++i) {
+        const auto &f = free_slots[i];
+        if(f.w >= sw && f.h >= sh && (best == free_slots.size() || f.w*f.h < free_slots[best].w*free_slots[best].h)) {
+            best = i;
+        }
+    }
+    if(best < free_slots.size()) {
+        slot = free_slots[best];
+        free_slots[best] = free_slots.back();
+        free_slots.pop_back();
+        ++used;
+        return true;
+    }
+    if(sw > w || sh > h) {
+        return false;
+    }
+    if(x + sw > w) {
+        x = 0;
+        y += shelf_h;
+        shelf_h = 0;
+    }
+    if(y + sh > h) {
+        return false;
+    }
+    slot = SDL_Rect{x, y, sw, sh};
+    x += sw;
+    shelf_h = std::max(shelf_h, sh);
+    ++used;
+    return true;
+}
+
+void page_allocator::release(const SDL_Rect &slot) {
+    if(--used == 0) {
+        x = y = shelf_h = 0;
+        free_slots.clear();
+        return;
+    }
+    free_slots.push_back(slot);
+}
+
+texture_atlas::texture_atlas(SDL_Renderer *rend,
+        const std::vector<atlas_page_pixels> &page_pixels,
+        const atlas_layout &layout) {
+    const int max_size = renderer_max_size(rend);
+    for(const auto &p : page_pixels) {
+        if(p.w > max_size || p.h > max_size) {
+            upload_repacked(rend, page_pixels, layout, max_size);
+            return;
+        }
+    }
+    const bool use_bc3 = renderer_supports_bc3(rend);
+    for(const auto &p : page_pixels) {
+        SDL_Texture *tex = nullptr;
+        if(use_bc3 && p.bc3) {
+            tex = create_bc3_texture(rend, p.w, p.h, p.bc3);
+            if(!tex) {
+                printf("BC3 upload failed, using uncompressed atlas page.\n");
+            }
+        }
+        if(!tex) {
+            tex = SDL_CreateTexture(rend, p.format, SDL_TEXTUREACCESS_STATIC, p.w, p.h);
+            if(!tex || SDL_UpdateTexture(tex, nullptr, p.pixels, p.pitch) != 0) {
+                printf("Atlas texture upload failed: %s\n", SDL_GetError());
+                std::abort();
+            }
+        }
+        SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
+        pages.push_back(tex);
+    }
+    sprites.reserve(layout.rects.size());
+    for(size_t i=0; i<layout.rects.size(); ++i) {
+        sprites.push_back(sprite{pages[layout.page_of[i]], layout.rects[i]});
+    }
+}
+
+void texture_atlas::upload_repacked(SDL_Renderer *rend,
+        const std::vector<atlas_page_pixels> &page_pixels,
+        const atlas_layout &layout,
+        int max_size) {
+    printf("Atlas pages are larger than %d pixels, packing them again.\n", max_size);
+    // Surfaces that point into the stored pages, one per sprite.
+    std::vector<SDL_Surface*> images;
+    for(size_t i=0; i<layout.rects.size(); ++i) {
+        const auto &p = page_pixels[layout.page_of[i]];
+        const auto &r = layout.rects[i];
+        const Uint8 *src = static_cast<const Uint8*>(p.pixels) + size_t(r.y)*p.pitch + size_t(r.x)*SDL_BYTESPERPIXEL(p.format);
+        SDL_Surface *s = SDL_CreateRGBSurfaceWithFormatFrom(const_cast<Uint8*>(src), r.w, r.h,
+                SDL_BITSPERPIXEL(p.format), p.pitch, p.format);
+        if(!s) {
+            printf("Sprite surface creation failed: %s\n", SDL_GetError());
+            std::abort();
+        }
+        images.push_back(s);
+    }
+    atlas_layout packed;
+    auto surfaces = compose_pages(images, max_size, page_pixels.front().format, packed);
+    for(auto *s : images) {
+        SDL_FreeSurface(s);
+    }
+    for(auto *s : surfaces) {
+        SDL_Texture *tex = SDL_CreateTexture(rend, s->format->format, SDL_TEXTUREACCESS_STATIC, s->w, s->h);
+        if(!tex || SDL_UpdateTexture(tex, nullptr, s->pixels, s->pitch) != 0) {
+            printf("Atlas texture upload failed: %s\n", SDL_GetError());
+            std::abort();
+        }
+        SDL_FreeSurface(s);
+        SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
+        pages.push_back(tex);
+    }
+    sprites.reserve(packed.rects.size());
+    for(size_t i=0; i<packed.rects.size(); ++i) {
+        sprites.push_back(sprite{pages[packed.page_of[i]], packed.rects[i]});
+    }
+}
+
+texture_atlas::~texture_atlas() {
+    for(auto *t : pages) {
+        SDL_DestroyTexture(t);
+    }
+}
@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include<SDL.h>
+#include<vector>
+
+// A sub-rectangle of an atlas page.
+struct sprite {
+    SDL_Texture *tex;
+    SDL_Rect src;
+};
+
+struct atlas_layout {
+    struct page {
+        int w;
+        int h;
+    };
+    std::vector<page> pages;
+    // One entry per packed rectangle, in input order.
+    std::vector<int> page_of;
+    std::vector<SDL_Rect> rects;
+};
+
+const int atlas_max_size = 4096;
+
+// Shelf packs rectangles of the given sizes into as few pages of at
+// most max_size x max_size as possible. Pages are powers of two.
+atlas_layout pack_rects(const std::vector<SDL_Point> &sizes, int max_size, int padding);
+
+// Packs images into the given maximum page size and blits them onto
+// pages of the given pixel format. The caller owns the returned surfaces.
+std::vector<SDL_Surface*> compose_pages(const std::vector<SDL_Surface*> &images,
+        int max_size,
+        Uint32 format,
+        atlas_layout &layout);
+
+// Pixel data of a page that has already been composed, for example
+// one stored in an asset pack.
+struct atlas_page_pixels {
+    Uint32 format;
+    int w;
+    int h;
+    int pitch;
+    const void *pixels;
+    // The same page in BC3, used instead if the renderer can.
+    const void *bc3 = nullptr;
+};
+
+// Hands out rectangles of one page as images arrive, for atlases that
+// are filled while running. Rectangles go on shelves like in
+// pack_rects. Released ones are reused by images that fit in them,
+// and the page starts over once everything has been released.
+struct page_allocator {
+    page_allocator(int w, int h);
+
+    // The slot includes the padding, the image goes at its top left.
+    bool allocate(int w, int h, SDL_Rect &slot);
+    void release(const SDL_Rect &slot);
+
+    int live() const { return used; }
+
+private:
+    int w;
+    int h;
+    int x = 0;
+    int y = 0;
+    int shelf_h = 0;
+    int used = 0;
+    std::vector<SDL_Rect> free_slots;
+};
+
+// Textures of prebaked atlas pages.
+struct texture_atlas {
+    std::vector<SDL_Texture*> pages;
+    std::vector<sprite> sprites;
+
+    // Uploads prebaked pages as is. The layout's page list is ignored.
+    // If a page is bigger than the renderer can take, its sprites are
+    // packed again into pages that fit.
+    texture_atlas(SDL_Renderer *rend,
+            const std::vector<atlas_page_pixels> &page_pixels,
+            const atlas_layout &layout);
+    ~texture_atlas();
+
+    texture_atlas(const texture_atlas &) = delete;
+    texture_atlas& operator=(const texture_atlas &) = delete;
+
+private:
+    void upload_repacked(SDL_Renderer *rend,
+            const std::vector<atlas_page_pixels> &page_pixels,
+            const atlas_layout &layout,
+            int max_size);
+};
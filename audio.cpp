@@ -0,0 +1,367 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#include"audio.hpp"
+#include<algorithm>
+#include<cmath>
+#include<cstdio>
+
+namespace {
+
+// Streams are mixed through a stack buffer of this many samples.
+const int stream_mix_block = 1024;
+
+const float quarter_pi = 0.78539816f;
+
+// How often an idle main loop looks whether a stream has ended.
+const int stream_poll_ms = 100;
+
+Uint32 pack_gain(stereo_gain g) {
+    return Uint32(g.left) | (Uint32(g.right) << 16);
+}
+
+}
+
+stereo_gain spatialize(float x, float y, float listener_x, float listener_y,
+        float half_width, float ref_distance) {
+    const float dx = x - listener_x;
+    const float dy = y - listener_y;
+    const float pan = std::min(1.0f, std::max(-1.0f, dx/half_width));
+    const float dist = std::sqrt(dx*dx + dy*dy);
+    const float att = dist > ref_distance ? ref_distance/dist : 1.0f;
+    const float angle = (pan + 1.0f)*quarter_pi;
+    // cos and sin are both 1/sqrt(2) in the middle, scale that to full volume.
+    const float scale = att*MIX_MAX_VOLUME*1.41421356f;
+    auto to_volume = [](float v) { return std::min(MIX_MAX_VOLUME, int(v + 0.5f)); };
+    return stereo_gain{to_volume(std::cos(angle)*scale), to_volume(std::sin(angle)*scale)};
+}
+
+audiocontrol::audiocontrol() : dev(0), voices{}, dropped_commands(0), stolen_voices(0),
+        master_volume(MIX_MAX_VOLUME), kernel(select_mix_kernel()),
+        out_freq(MIX_DEFAULT_FREQUENCY), out_channels(2), hooked(false), chunk_ends{},
+        next_chunk_end(0), num_chunk_uses(0), next_serial(0) {
+    for(auto &v : voices) {
+        v.stream = -1;
+    }
+    for(auto &g : emitter_gains) {
+        g.store(pack_gain(stereo_gain{MIX_MAX_VOLUME, MIX_MAX_VOLUME}), std::memory_order_relaxed);
+    }
+    printf("Using %s audio mixing kernel.\n", kernel.name);
+}
+
+audiocontrol::~audiocontrol() {
+    stop();
+    if(dev) {
+        SDL_CloseAudioDevice(dev);
+    }
+}
+
+bool audiocontrol::open_device(int freq, int channels, int frames) {
+    SDL_AudioSpec want, have;
+    SDL_memset(&want, 0, sizeof(want));
+    want.freq = freq;
+    want.format = AUDIO_S16SYS;
+    want.channels = Uint8(channels);
+    want.samples = Uint16(frames);
+    want.callback = audiocallback;
+    want.userdata = this;
+    dev = SDL_OpenAudioDevice(nullptr, 0, &want, &have, 0);
+    if(!dev) {
+        printf("Could not open audio device: %s\n", SDL_GetError());
+        return false;
+    }
+    printf("Audio device opened with %d frame buffer.\n", int(have.samples));
+    return true;
+}
+
+void audiocontrol::open_streams(int freq, int channels) {
+    out_freq = freq;
+    out_channels = channels;
+    streams.open(freq, channels);
+}
+
+void audiocontrol::hook_mixer() {
+    Mix_HookMusic(audiocallback, this);
+    hooked = true;
+}
+
+void audiocontrol::stop() {
+    if(hooked) {
+        // Returns only once the callback is no longer running.
+        Mix_HookMusic(nullptr, nullptr);
+        hooked = false;
+    }
+    if(dev) {
+        // A paused device does not call back, the lock waits out a
+        // callback that is already running.
+        SDL_PauseAudioDevice(dev, 1);
+        SDL_LockAudioDevice(dev);
+    }
+    // The audio thread is done with everything below.
+    play_command cmd;
+    while(commands.pop(cmd)) {
+    }
+    for(auto &v : voices) {
+        v.chunk = nullptr;
+        v.data = nullptr;
+        v.stream = -1;
+    }
+    const Mix_Chunk *done;
+    while(finished.pop(done)) {
+    }
+    num_chunk_uses = 0;
+    streams.close();
+    if(dev) {
+        SDL_UnlockAudioDevice(dev);
+    }
+}
+
+void audiocontrol::play(const sound_asset &s, const play_params &p) {
+    if(s.chunk) {
+        play_sample(s.chunk, p);
+    } else if(s.encoded.data) {
+        play_stream(s.encoded, p);
+    }
+}
+
+void audiocontrol::play_sample(Mix_Chunk *sample, const play_params &p) {
+    // Every play is counted until the audio thread hands it back.
+    collect();
+    int use = 0;
+    while(use < num_chunk_uses && chunk_uses[use].chunk != sample) {
+        ++use;
+    }
+    if(use == num_chunk_uses && num_chunk_uses == max_commands + max_voices) {
+        dropped_commands.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if(!commands.push(play_command{sample, -1, p})) {
+        dropped_commands.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if(use == num_chunk_uses) {
+        chunk_uses[num_chunk_uses++] = chunk_use{sample, 0};
+    }
+    ++chunk_uses[use].plays;
+    // Only a hint for idle waits, so a voice that gets stolen or
+    // starts late does not matter.
+    const Uint64 bytes_per_second = Uint64(out_freq)*out_channels*sizeof(Sint16);
+    const Uint32 ms = Uint32(Uint64(sample->alen)*1000/bytes_per_second) + 1;
+    chunk_ends[next_chunk_end] = SDL_GetTicks() + ms;
+    next_chunk_end = (next_chunk_end + 1) % max_voices;
+}
+
+void audiocontrol::play_stream(const encoded_sound &s, const play_params &p) {
+    const int slot = streams.start(s);
+    if(slot < 0) {
+        dropped_commands.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if(!commands.push(play_command{nullptr, slot, p})) {
+        // The audio thread never saw the slot, so it can be given back here.
+        streams.release(slot);
+        dropped_commands.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+int audiocontrol::ms_to_voice_end() const {
+    const Uint32 now = SDL_GetTicks();
+    int soonest = streams.active() ? stream_poll_ms : -1;
+    for(const auto end : chunk_ends) {
+        if(SDL_TICKS_PASSED(now, end)) {
+            continue;
+        }
+        const int ms = int(end - now);
+        if(soonest < 0 || ms < soonest) {
+            soonest = ms;
+        }
+    }
+    return soonest;
+}
+
+bool audiocontrol::uses(const sound_asset &s) {
+    collect();
+    if(s.chunk) {
+        for(int i=0; i<num_chunk_uses; ++i) {
+            if(chunk_uses[i].chunk == s.chunk) {
+                return true;
+            }
+        }
+    }
+    return s.encoded.data && streams.uses(s.encoded.data);
+}
+
+void audiocontrol::collect() {
+    const Mix_Chunk *done;
+    while(finished.pop(done)) {
+        for(int i=0; i<num_chunk_uses; ++i) {
+            if(chunk_uses[i].chunk == done) {
+                if(--chunk_uses[i].plays == 0) {
+                    chunk_uses[i] = chunk_uses[--num_chunk_uses];
+                }
+                break;
+            }
+        }
+    }
+}
+
+void audiocontrol::chunk_done(const Mix_Chunk *c) {
+    // There is room for every play that can be outstanding.
+    if(c) {
+        finished.push(c);
+    }
+}
+
+void audiocontrol::set_emitter(int emitter, stereo_gain g) {
+    emitter_gains[emitter].store(pack_gain(g), std::memory_order_relaxed);
+}
+
+void audiocontrol::start_voice(const play_command &cmd) {
+    voice *v = nullptr;
+    for(auto &candidate : voices) {
+        if(!candidate.data && candidate.stream < 0) {
+            v = &candidate;
+            break;
+        }
+    }
+    if(!v) {
+        v = steal_voice(cmd.params.priority);
+    }
+    if(!v) {
+        // Everything playing matters more, the same as SDL_mixer
+        // running out of channels.
+        if(cmd.stream >= 0) {
+            streams.release(cmd.stream);
+        }
+        chunk_done(cmd.chunk);
+        dropped_commands.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    v->chunk = cmd.chunk;
+    if(cmd.chunk) {
+        v->data = cmd.chunk->abuf;
+        v->len = cmd.chunk->alen;
+        v->volume = cmd.chunk->volume;
+    } else {
+        v->volume = MIX_MAX_VOLUME;
+    }
+    v->pos = 0;
+    v->stream = cmd.stream;
+    v->priority = cmd.params.priority;
+    v->emitter = cmd.params.emitter >= 0 && cmd.params.emitter < max_emitters ? cmd.params.emitter : -1;
+    v->serial = next_serial++;
+    if(cmd.params.trace_id) {
+        // Lost if the main thread is not collecting, which
+        // only costs the trace point.
+        traced.push(audio_trace{cmd.params.trace_id, SDL_GetPerformanceCounter()});
+    }
+}
+
+voice* audiocontrol::steal_voice(int priority) {
+    // Lowest priority first, then the quietest and then the oldest.
+    voice *victim = nullptr;
+    int victim_gain = 0;
+    for(auto &v : voices) {
+        if(v.priority > priority) {
+            continue;
+        }
+        const stereo_gain g = voice_gain(v);
+        const int gain = std::max(g.left, g.right);
+        if(!victim || v.priority < victim->priority ||
+                (v.priority == victim->priority && (gain < victim_gain ||
+                (gain == victim_gain && Sint32(v.serial - victim->serial) < 0)))) {
+            victim = &v;
+            victim_gain = gain;
+        }
+    }
+    if(victim) {
+        if(victim->stream >= 0) {
+            streams.release(victim->stream);
+        }
+        chunk_done(victim->chunk);
+        victim->chunk = nullptr;
+        victim->data = nullptr;
+        victim->stream = -1;
+        stolen_voices.fetch_add(1, std::memory_order_relaxed);
+    }
+    return victim;
+}
+
+stereo_gain audiocontrol::voice_gain(const voice &v) const {
+    int left = v.volume;
+    int right = v.volume;
+    if(v.emitter >= 0) {
+        const Uint32 packed = emitter_gains[v.emitter].load(std::memory_order_relaxed);
+        left = (left*int(packed & 0xFFFF)) >> 7;
+        right = (right*int(packed >> 16)) >> 7;
+    }
+    if(out_channels != 2) {
+        // Panning is meaningless without exactly two channels.
+        left = right = (left + right)/2;
+    }
+    return stereo_gain{left, right};
+}
+
+void audiocontrol::end_voice(voice &v) {
+    if(v.stream >= 0) {
+        streams.release(v.stream);
+    }
+    chunk_done(v.chunk);
+    v.chunk = nullptr;
+    v.data = nullptr;
+    v.stream = -1;
+}
+
+void audiocontrol::produce(Uint8 *stream, int len) {
+    play_command cmd;
+    while(commands.pop(cmd)) {
+        start_voice(cmd);
+    }
+    Sint16 *out = reinterpret_cast<Sint16*>(stream);
+    const int out_samples = len/int(sizeof(Sint16));
+    SDL_memset(stream, 0, len);
+    for(auto &v : voices) {
+        if(!v.data && v.stream < 0) {
+            continue;
+        }
+        const stereo_gain g = voice_gain(v);
+        if(v.stream >= 0) {
+            Sint16 block[stream_mix_block];
+            for(int done=0; done<out_samples;) {
+                const int got = streams.read(v.stream, block, std::min(stream_mix_block, out_samples - done));
+                if(got == 0) {
+                    break;
+                }
+                // Reads are not always whole frames, so the channel
+                // at an odd offset is the right one.
+                if(done & 1) {
+                    kernel.add(out + done, block, got, g.right, g.left);
+                } else {
+                    kernel.add(out + done, block, got, g.left, g.right);
+                }
+                done += got;
+            }
+            // An underrun just leaves a gap, the voice ends with the data.
+            if(streams.finished(v.stream)) {
+                end_voice(v);
+            }
+            continue;
+        }
+        const Sint16 *in = reinterpret_cast<const Sint16*>(v.data + v.pos);
+        const int samples = std::min(out_samples, int((v.len - v.pos)/sizeof(Sint16)));
+        kernel.add(out, in, samples, g.left, g.right);
+        v.pos += Uint32(samples*sizeof(Sint16));
+        if(v.pos >= v.len) {
+            end_voice(v);
+        }
+    }
+    const int vol = master_volume.load(std::memory_order_relaxed);
+    if(vol < MIX_MAX_VOLUME) {
+        kernel.scale(out, out_samples, vol);
+    }
+}
+
+void audiocallback(void *data, Uint8* stream, int len) {
+    auto control = reinterpret_cast<audiocontrol*>(data);
+    control->produce(stream, len);
+}
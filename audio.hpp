@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include<SDL.h>
+#include<SDL_mixer.h>
+#include"spsc.hpp"
+#include"mixkernels.hpp"
+#include"soundstream.hpp"
+#include"inputtrace.hpp"
+#include<atomic>
+
+const int max_voices = 16;
+const int max_commands = 64;
+// Positions that voices can follow, see audiocontrol::set_emitter().
+const int max_emitters = 32;
+
+// When all voices are busy a new sound replaces the lowest priority
+// voice, but only one of equal or lower priority.
+enum sound_priority : int {
+    PRIORITY_LOW,
+    PRIORITY_NORMAL,
+    PRIORITY_HIGH,
+};
+
+// Per channel volumes, 0-128.
+struct stereo_gain {
+    int left;
+    int right;
+};
+
+// Equal power panning by the horizontal offset from the listener,
+// which reaches full left or right at half_width, and inverse
+// distance attenuation beyond ref_distance.
+stereo_gain spatialize(float x, float y, float listener_x, float listener_y,
+        float half_width, float ref_distance);
+
+enum class audio_backend {
+    // Hooked into SDL_mixer's output stream.
+    mixer,
+    // A raw SDL audio device with its own, smaller buffer.
+    device,
+};
+
+const int default_mixer_buffer = 1024;
+const int default_device_buffer = 256;
+
+struct play_params {
+    int priority = PRIORITY_NORMAL;
+    // Emitter whose gain the voice follows, -1 to play centered.
+    int emitter = -1;
+    // Input trace id, 0 if not traced.
+    Uint32 trace_id = 0;
+};
+
+// Plays either a chunk or, if it is null, a stream slot.
+struct play_command {
+    const Mix_Chunk *chunk;
+    int stream;
+    play_params params;
+};
+
+struct voice {
+    // Null for streams.
+    const Mix_Chunk *chunk;
+    const Uint8 *data;
+    Uint32 len;
+    Uint32 pos;
+    int volume;
+    // Stream slot the voice reads from, -1 if it plays data.
+    int stream;
+    int priority;
+    int emitter;
+    // Start order, used to steal the oldest of equal voices.
+    Uint32 serial;
+};
+
+// Mixes voices into the output stream. The main thread only talks to
+// the audio thread through the command queue and the emitter gains,
+// so neither playing nor produce() takes a lock or allocates. The
+// output format is assumed to be signed 16 bit.
+struct audiocontrol {
+    SDL_AudioDeviceID dev;
+    spsc_queue<play_command, max_commands> commands;
+    // Audio thread to main thread, one entry for every played chunk
+    // once nothing on the audio thread refers to it any more. Drained
+    // on every play, so it has room for all plays that can be queued
+    // or playing at once.
+    spsc_queue<const Mix_Chunk*, 256> finished;
+    voice voices[max_voices];
+    // Packed stereo_gain per emitter, left in the low half.
+    std::atomic<Uint32> emitter_gains[max_emitters];
+    std::atomic<int> dropped_commands;
+    std::atomic<int> stolen_voices;
+    std::atomic<int> master_volume;
+    mix_kernel kernel;
+    stream_player streams;
+    // When traced sounds started mixing, for the main thread to collect.
+    spsc_queue<audio_trace, 256> traced;
+
+    audiocontrol();
+    ~audiocontrol();
+
+    audiocontrol(const audiocontrol &) = delete;
+    audiocontrol& operator=(const audiocontrol &) = delete;
+
+    // Opens a raw device that calls produce() directly. SDL converts
+    // if the hardware does not support the requested format.
+    bool open_device(int freq, int channels, int frames);
+    // Streaming needs to know the output format. Call once it is known.
+    void open_streams(int freq, int channels);
+    // Mixes into SDL_mixer's output stream instead of a device.
+    void hook_mixer();
+    // Stops calling produce() and forgets every voice, queued command
+    // and stream, so that the sounds can be freed afterwards. Nothing
+    // plays after this.
+    void stop();
+
+    void play(const sound_asset &s, const play_params &p = play_params());
+    void play_sample(Mix_Chunk *sample, const play_params &p = play_params());
+    void play_stream(const encoded_sound &s, const play_params &p = play_params());
+    // Moves an emitter, voices following it pick the change up on the
+    // next buffer.
+    void set_emitter(int emitter, stereo_gain g);
+    void produce(Uint8 *stream, int len);
+    // Main thread. Milliseconds until a voice may have finished, or
+    // -1 if nothing is playing, so that idle waits can end then.
+    // Streams are of unknown length and are checked periodically.
+    int ms_to_voice_end() const;
+    // Main thread. Whether the audio side may still be reading the
+    // sound's data. It may only be freed once this is false.
+    bool uses(const sound_asset &s);
+
+private:
+    void start_voice(const play_command &cmd);
+    voice* steal_voice(int priority);
+    void end_voice(voice &v);
+    void chunk_done(const Mix_Chunk *c);
+    void collect();
+    stereo_gain voice_gain(const voice &v) const;
+
+    int out_freq;
+    int out_channels;
+    bool hooked;
+    // Main thread only. When the last started chunks end.
+    Uint32 chunk_ends[max_voices];
+    int next_chunk_end;
+    // Main thread only. Chunks with plays that are queued or playing.
+    struct chunk_use {
+        const Mix_Chunk *chunk;
+        int plays;
+    };
+    chunk_use chunk_uses[max_commands + max_voices];
+    int num_chunk_uses;
+    // Audio thread only.
+    Uint32 next_serial;
+};
+
+void audiocallback(void *data, Uint8* stream, int len);
+
+// Stops the audio when it goes out of scope. Declared right after the
+// sounds that voices may point to, it runs before they are freed.
+struct audio_stopper {
+    audiocontrol &control;
+
+    ~audio_stopper() { control.stop(); }
+};
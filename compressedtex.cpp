@@ -0,0 +1,164 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#include"compressedtex.hpp"
+#include<SDL_opengl.h>
+#include<algorithm>
+#include<cstdlib>
+#include<cstring>
+#include<utility>
+
+namespace {
+
+typedef GLenum (APIENTRY *get_error_func)();
+
+struct rgba {
+    int r, g, b, a;
+};
+
+rgba unpack(Uint32 p) {
+    return rgba{int((p >> 16) & 0xFF), int((p >> 8) & 0xFF), int(p & 0xFF), int(p >> 24)};
+}
+
+Uint16 to_565(const rgba &c) {
+    return Uint16(((c.r*31 + 127)/255) << 11 | ((c.g*63 + 127)/255) << 5 | (c.b*31 + 127)/255);
+}
+
+rgba from_565(Uint16 c) {
+    const int r = c >> 11;
+    const int g = (c >> 5) & 63;
+    const int b = c & 31;
+    return rgba{(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), 255};
+}
+
+int distance(const rgba &x, const rgba &y) {
+    return (x.r - y.r)*(x.r - y.r) + (x.g - y.g)*(x.g - y.g) + (x.b - y.b)*(x.b - y.b);
+}
+
+// Bounding box endpoints, which is plenty for flat sprite art.
+void encode_block(const rgba px[16], Uint8 *out) {
+    int amin = 255, amax = 0;
+    rgba lo{255, 255, 255, 0}, hi{0, 0, 0, 0};
+    for(int i=0; i<16; ++i) {
+        amin = std::min(amin, px[i].a);
+        amax = std::max(amax, px[i].a);
+        lo = rgba{std::min(lo.r, px[i].r), std::min(lo.g, px[i].g), std::min(lo.b, px[i].b), 0};
+        hi = rgba{std::max(hi.r, px[i].r), std::max(hi.g, px[i].g), std::max(hi.b, px[i].b), 0};
+    }
+
+    // Alpha: a0 > a1 selects the eight value ramp.
+    int alphas[8] = {amax, amin};
+    for(int i=1; i<7; ++i) {
+        alphas[i + 1] = ((7 - i)*amax + i*amin)/7;
+    }
+    Uint64 abits = 0;
+    for(int i=0; i<16; ++i) {
+        int best = 0;
+        for(int j=1; j<8; ++j) {
+            if(std::abs(alphas[j] - px[i].a) < std::abs(alphas[best] - px[i].a)) {
+                best = j;
+            }
+        }
+        abits |= Uint64(best) << (3*i);
+    }
+    out[0] = Uint8(amax);
+    out[1] = Uint8(amin);
+    for(int i=0; i<6; ++i) {
+        out[2 + i] = Uint8(abits >> (8*i));
+    }
+
+    // Color: BC3 always uses the four color ramp.
+    Uint16 c0 = to_565(hi);
+    Uint16 c1 = to_565(lo);
+    if(c0 < c1) {
+        std::swap(c0, c1);
+    }
+    const rgba e0 = from_565(c0);
+    const rgba e1 = from_565(c1);
+    const rgba colors[4] = {e0, e1,
+        rgba{(2*e0.r + e1.r)/3, (2*e0.g + e1.g)/3, (2*e0.b + e1.b)/3, 255},
+        rgba{(e0.r + 2*e1.r)/3, (e0.g + 2*e1.g)/3, (e0.b + 2*e1.b)/3, 255}};
+    Uint32 cbits = 0;
+    for(int i=0; i<16; ++i) {
+        int best = 0;
+        for(int j=1; j<4; ++j) {
+            if(distance(colors[j], px[i]) < distance(colors[best], px[i])) {
+                best = j;
+            }
+        }
+        cbits |= Uint32(best) << (2*i);
+    }
+    out[8] = Uint8(c0);
+    out[9] = Uint8(c0 >> 8);
+    out[10] = Uint8(c1);
+    out[11] = Uint8(c1 >> 8);
+    for(int i=0; i<4; ++i) {
+        out[12 + i] = Uint8(cbits >> (8*i));
+    }
+}
+
+}
+
+std::vector<Uint8> encode_bc3(const void *pixels, int w, int h, int pitch) {
+    std::vector<Uint8> out(bc3_size(w, h));
+    Uint8 *dst = out.data();
+    for(int by=0; by<h; by+=4) {
+        for(int bx=0; bx<w; bx+=4) {
+            rgba px[16];
+            for(int y=0; y<4; ++y) {
+                const Uint32 *row = reinterpret_cast<const Uint32*>(
+                        static_cast<const Uint8*>(pixels) + (by + y)*pitch) + bx;
+                for(int x=0; x<4; ++x) {
+                    px[4*y + x] = unpack(row[x]);
+                }
+            }
+            encode_block(px, dst);
+            dst += 16;
+        }
+    }
+    return out;
+}
+
+bool renderer_supports_bc3(SDL_Renderer *rend) {
+    SDL_RendererInfo info;
+    if(SDL_GetRendererInfo(rend, &info) != 0) {
+        return false;
+    }
+    if(strcmp(info.name, "opengl") != 0 && strcmp(info.name, "opengles2") != 0) {
+        return false;
+    }
+    return SDL_GL_ExtensionSupported("GL_EXT_texture_compression_s3tc") &&
+            SDL_GL_GetProcAddress("glCompressedTexImage2D");
+}
+
+SDL_Texture* create_bc3_texture(SDL_Renderer *rend, int w, int h, const void *data) {
+    auto compressed_tex_image = reinterpret_cast<PFNGLCOMPRESSEDTEXIMAGE2DPROC>(
+            SDL_GL_GetProcAddress("glCompressedTexImage2D"));
+    auto get_error = reinterpret_cast<get_error_func>(SDL_GL_GetProcAddress("glGetError"));
+    if(!compressed_tex_image || !get_error) {
+        return nullptr;
+    }
+    // ABGR8888 is plain GL_RGBA on both GL backends. With ARGB8888
+    // opengles2 would swap red and blue in its shader.
+    SDL_Texture *tex = SDL_CreateTexture(rend, SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_STATIC, w, h);
+    if(!tex) {
+        return nullptr;
+    }
+    float texw, texh;
+    // Binding flushes SDL's queued draws. Rectangle textures, whose
+    // coordinates are in pixels, can not be compressed.
+    if(SDL_GL_BindTexture(tex, &texw, &texh) != 0 || texw != 1.0f || texh != 1.0f) {
+        SDL_DestroyTexture(tex);
+        return nullptr;
+    }
+    get_error();
+    compressed_tex_image(GL_TEXTURE_2D, 0, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, w, h, 0,
+            GLsizei(bc3_size(w, h)), data);
+    const bool ok = get_error() == GL_NO_ERROR;
+    SDL_GL_UnbindTexture(tex);
+    if(!ok) {
+        SDL_DestroyTexture(tex);
+        return nullptr;
+    }
+    return tex;
+}
@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include<SDL.h>
+#include<vector>
+
+// SDL_Renderer has no compressed texture formats. On the OpenGL
+// backends the GL texture behind an SDL_Texture can be given
+// compressed storage instead, which SDL then draws like any other.
+// Other backends use the uncompressed pages.
+const Uint32 format_bc3 = SDL_DEFINE_PIXELFOURCC('D', 'X', 'T', '5');
+
+inline size_t bc3_size(int w, int h) {
+    return size_t((w + 3)/4)*size_t((h + 3)/4)*16;
+}
+
+// Compresses ARGB8888 pixels to BC3 (DXT5). Width and height must be
+// multiples of four.
+std::vector<Uint8> encode_bc3(const void *pixels, int w, int h, int pitch);
+
+// Whether upload_bc3 can be used on textures of this renderer. Must
+// be called on the render thread.
+bool renderer_supports_bc3(SDL_Renderer *rend);
+
+// Creates a w x h texture with the BC3 data as its storage.
+SDL_Texture* create_bc3_texture(SDL_Renderer *rend, int w, int h, const void *data);
@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#include"driverconfig.hpp"
+#include<SDL.h>
+#include<cstdio>
+#include<cstring>
+
+namespace {
+
+const char config_name[] = "render-driver.txt";
+
+std::string current_fingerprint() {
+    SDL_version v;
+    SDL_GetVersion(&v);
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%d.%d.%d", int(v.major), int(v.minor), int(v.patch));
+    std::string fp(buf);
+    for(int i=0; i<SDL_GetNumRenderDrivers(); ++i) {
+        SDL_RendererInfo info;
+        if(SDL_GetRenderDriverInfo(i, &info) == 0) {
+            fp += ' ';
+            fp += info.name;
+        }
+    }
+    return fp;
+}
+
+// Reads "key=value" into value, without the line end.
+bool read_value(FILE *f, const char *key, std::string &value) {
+    char line[512];
+    if(!fgets(line, sizeof(line), f)) {
+        return false;
+    }
+    const size_t keylen = strlen(key);
+    if(strncmp(line, key, keylen) != 0 || line[keylen] != '=') {
+        return false;
+    }
+    value = line + keylen + 1;
+    while(!value.empty() && (value.back() == '\n' || value.back() == '\r')) {
+        value.pop_back();
+    }
+    return true;
+}
+
+}
+
+driver_config::driver_config() : fingerprint(current_fingerprint()) {
+    char *dir = SDL_GetPrefPath("jpakkane", "sdltest");
+    if(dir) {
+        path = std::string(dir) + config_name;
+        SDL_free(dir);
+    }
+}
+
+bool driver_config::load(std::string &driver) const {
+    if(path.empty()) {
+        return false;
+    }
+    FILE *f = fopen(path.c_str(), "r");
+    if(!f) {
+        return false;
+    }
+    std::string fp;
+    const bool ok = read_value(f, "system", fp) && read_value(f, "driver", driver);
+    fclose(f);
+    return ok && fp == fingerprint && !driver.empty();
+}
+
+bool driver_config::save(const std::string &driver) const {
+    if(path.empty()) {
+        printf("No preference directory, the render driver choice is not saved.\n");
+        return false;
+    }
+    FILE *f = fopen(path.c_str(), "w");
+    if(!f) {
+        printf("Could not write %s.\n", path.c_str());
+        return false;
+    }
+    fprintf(f, "system=%s\ndriver=%s\n", fingerprint.c_str(), driver.c_str());
+    fclose(f);
+    return true;
+}
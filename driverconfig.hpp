@@ -0,0 +1,23 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include<string>
+
+// Remembers which render driver a startup probe chose, in the user's
+// SDL preference directory. The choice is tied to the SDL version and
+// the set of available drivers, and is forgotten if either changes.
+struct driver_config {
+    driver_config();
+
+    // Returns false if nothing valid is stored.
+    bool load(std::string &driver) const;
+    bool save(const std::string &driver) const;
+
+    const std::string& file() const { return path; }
+
+private:
+    std::string path;
+    std::string fingerprint;
+};
@@ -0,0 +1,163 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#include"entities.hpp"
+#include"motiontables.hpp"
+#include<cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ENTITIES_HAVE_SSE2
+#include<emmintrin.h>
+#endif
+
+namespace {
+
+// Taylor series of sin(2*pi*x) up to x^9. Accurate enough on
+// [-0.25, 0.25], which the range reduction below guarantees.
+const float c1 = 6.28318531f;
+const float c3 = -41.3417022f;
+const float c5 = 81.6052493f;
+const float c7 = -76.7058597f;
+const float c9 = 42.0587743f;
+
+inline float sin_poly(float u) {
+    const float u2 = u*u;
+    return u*(c1 + u2*(c3 + u2*(c5 + u2*(c7 + u2*c9))));
+}
+
+// Reduces to [-0.5, 0.5] and then folds around +-0.25, using
+// sin(2*pi*(0.5 - u)) = sin(2*pi*u).
+inline float reduce(float turns) {
+    const float u = turns - std::nearbyint(turns);
+    const float a = std::fabs(u);
+    return std::copysign(std::fmin(a, 0.5f - a), u);
+}
+
+#ifdef ENTITIES_HAVE_SSE2
+
+inline __m128 sin_turns4(__m128 t) {
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+    // Round to nearest with the default MXCSR rounding mode.
+    const __m128 u = _mm_sub_ps(t, _mm_cvtepi32_ps(_mm_cvtps_epi32(t)));
+    const __m128 sign = _mm_and_ps(u, sign_mask);
+    const __m128 a = _mm_andnot_ps(sign_mask, u);
+    const __m128 r = _mm_or_ps(_mm_min_ps(a, _mm_sub_ps(_mm_set1_ps(0.5f), a)), sign);
+    const __m128 r2 = _mm_mul_ps(r, r);
+    __m128 p = _mm_set1_ps(c9);
+    p = _mm_add_ps(_mm_mul_ps(p, r2), _mm_set1_ps(c7));
+    p = _mm_add_ps(_mm_mul_ps(p, r2), _mm_set1_ps(c5));
+    p = _mm_add_ps(_mm_mul_ps(p, r2), _mm_set1_ps(c3));
+    p = _mm_add_ps(_mm_mul_ps(p, r2), _mm_set1_ps(c1));
+    return _mm_mul_ps(p, r);
+}
+
+// The table lookup with the index arithmetic vectorized. SSE2 has no
+// gather, so the loads are still one at a time.
+inline __m128 sin_lut4(__m128 t) {
+    const float *v = sine_table<motion_lut_size>::values.data();
+    const __m128 f = _mm_mul_ps(t, _mm_set1_ps(float(motion_lut_size)));
+    __m128i whole = _mm_cvttps_epi32(f);
+    // Compare masks are -1, which turns truncation into floor.
+    whole = _mm_add_epi32(whole, _mm_castps_si128(_mm_cmplt_ps(f, _mm_cvtepi32_ps(whole))));
+    const __m128 frac = _mm_sub_ps(f, _mm_cvtepi32_ps(whole));
+    whole = _mm_and_si128(whole, _mm_set1_epi32(int(motion_lut_size - 1)));
+    alignas(16) int idx[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(idx), whole);
+    const __m128 a = _mm_setr_ps(v[idx[0]], v[idx[1]], v[idx[2]], v[idx[3]]);
+    const __m128 b = _mm_setr_ps(v[idx[0] + 1], v[idx[1] + 1], v[idx[2] + 1], v[idx[3] + 1]);
+    return _mm_add_ps(a, _mm_mul_ps(frac, _mm_sub_ps(b, a)));
+}
+
+#endif
+
+const float two_pi = 6.28318531f;
+
+void update_libm(const float *phase, float *x, float *y, size_t begin, size_t end,
+        float ratio, const motion_params &m) {
+    for(size_t i=begin; i<end; ++i) {
+        const float t = phase[i] + ratio;
+        x[i] = m.x0 + m.amp_x*std::sin(two_pi*t);
+        y[i] = m.y0 + m.amp_y*std::cos(2*two_pi*t + two_pi/4);
+    }
+}
+
+void update_lut(const float *phase, float *x, float *y, size_t begin, size_t end,
+        float ratio, const motion_params &m) {
+    size_t i = begin;
+#ifdef ENTITIES_HAVE_SSE2
+    const __m128 r = _mm_set1_ps(ratio);
+    const __m128 x0 = _mm_set1_ps(m.x0);
+    const __m128 y0 = _mm_set1_ps(m.y0);
+    const __m128 ax = _mm_set1_ps(m.amp_x);
+    const __m128 ay = _mm_set1_ps(-m.amp_y);
+    for(; i+4 <= end; i+=4) {
+        const __m128 t = _mm_add_ps(_mm_loadu_ps(phase + i), r);
+        _mm_storeu_ps(x + i, _mm_add_ps(x0, _mm_mul_ps(ax, sin_lut4(t))));
+        _mm_storeu_ps(y + i, _mm_add_ps(y0, _mm_mul_ps(ay, sin_lut4(_mm_add_ps(t, t)))));
+    }
+#endif
+    for(; i<end; ++i) {
+        const float t = phase[i] + ratio;
+        x[i] = m.x0 + m.amp_x*sin_turns_lut(t);
+        y[i] = m.y0 - m.amp_y*sin_turns_lut(2*t);
+    }
+}
+
+}
+
+void entity_store::add(float entity_phase, int sprite, int entity_layer) {
+    phase.push_back(entity_phase);
+    sprite_id.push_back(sprite);
+    layer.push_back(entity_layer);
+}
+
+void entity_store::clear() {
+    phase.clear();
+    sprite_id.clear();
+    layer.clear();
+}
+
+float sin_turns(float turns) {
+    return sin_poly(reduce(turns));
+}
+
+float sin_turns_lut(float turns) {
+    return sine_table<motion_lut_size>::lookup(turns);
+}
+
+// cos(4*pi*t + pi/2) = -sin(4*pi*t), so both coordinates only need
+// sin_turns.
+void update_positions(const entity_store &ents, render_list &out,
+        size_t begin, size_t end, float ratio, const motion_params &m) {
+    const float *phase = ents.phase.data();
+    float *x = out.x.data();
+    float *y = out.y.data();
+    if(m.eval == motion_eval::libm) {
+        update_libm(phase, x, y, begin, end, ratio, m);
+        return;
+    }
+    if(m.eval == motion_eval::lut) {
+        update_lut(phase, x, y, begin, end, ratio, m);
+        return;
+    }
+    size_t i = begin;
+#ifdef ENTITIES_HAVE_SSE2
+    const __m128 r = _mm_set1_ps(ratio);
+    const __m128 x0 = _mm_set1_ps(m.x0);
+    const __m128 y0 = _mm_set1_ps(m.y0);
+    const __m128 ax = _mm_set1_ps(m.amp_x);
+    const __m128 ay = _mm_set1_ps(-m.amp_y);
+    for(; i+4 <= end; i+=4) {
+        const __m128 t = _mm_add_ps(_mm_loadu_ps(phase + i), r);
+        const __m128 sx = sin_turns4(t);
+        const __m128 sy = sin_turns4(_mm_add_ps(t, t));
+        _mm_storeu_ps(x + i, _mm_add_ps(x0, _mm_mul_ps(ax, sx)));
+        _mm_storeu_ps(y + i, _mm_add_ps(y0, _mm_mul_ps(ay, sy)));
+    }
+#endif
+    for(; i<end; ++i) {
+        const float t = phase[i] + ratio;
+        x[i] = m.x0 + m.amp_x*sin_turns(t);
+        y[i] = m.y0 - m.amp_y*sin_turns(2*t);
+    }
+}
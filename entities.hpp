@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include<cstddef>
+#include<vector>
+
+// Entity state as structure of arrays, so that the position update
+// can process several entities per instruction.
+struct entity_store {
+    std::vector<float> phase;
+    // Index into the atlas sprites.
+    std::vector<int> sprite_id;
+    // Higher layers are drawn on top, see visibility.hpp.
+    std::vector<int> layer;
+
+    void add(float entity_phase, int sprite, int entity_layer = 0);
+    void clear();
+    size_t size() const { return phase.size(); }
+};
+
+// Computed positions of every entity for one frame. Kept separate
+// from the entity state so that several frames can be in flight.
+struct render_list {
+    std::vector<float> x;
+    std::vector<float> y;
+
+    void resize(size_t n) {
+        x.resize(n);
+        y.resize(n);
+    }
+    size_t size() const { return x.size(); }
+};
+
+// How the motion curves are evaluated.
+enum class motion_eval {
+    // std::sin and std::cos as written below.
+    libm,
+    // A polynomial, vectorized where possible.
+    approx,
+    // An interpolated compile time table, see motiontables.hpp.
+    lut,
+};
+
+// Entities move along
+//   x = x0 + amp_x*sin(2*pi*t)
+//   y = y0 + amp_y*cos(4*pi*t + pi/2)
+// where t is the cycle position plus the entity's phase.
+struct motion_params {
+    float x0;
+    float y0;
+    float amp_x;
+    float amp_y;
+    motion_eval eval = motion_eval::approx;
+};
+
+// sin(2*pi*turns) with an absolute error below 4e-6.
+float sin_turns(float turns);
+// The same from the motion table.
+float sin_turns_lut(float turns);
+
+// Computes the positions of entities [begin, end). The list must
+// already have room for them.
+void update_positions(const entity_store &ents, render_list &out,
+        size_t begin, size_t end, float ratio, const motion_params &m);
@@ -0,0 +1,163 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#include"filewatcher.hpp"
+#include<cstdio>
+
+#ifdef _WIN32
+#include<windows.h>
+#elif defined(__linux__)
+#include<cerrno>
+#include<exception>
+#include<poll.h>
+#include<sys/inotify.h>
+#include<unistd.h>
+#endif
+
+file_watcher::file_watcher(const char *dir_, Uint32 wakeup_event_) : dir(dir_), wakeup_event(wakeup_event_) {
+#ifdef _WIN32
+    HANDLE h = CreateFileA(dir_, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+    if(h == INVALID_HANDLE_VALUE) {
+        printf("Could not watch %s.\n", dir_);
+        return;
+    }
+    dir_handle = h;
+    // Manual reset, so that it stays set however late the thread looks.
+    stop_event = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    if(!stop_event) {
+        printf("Could not watch %s.\n", dir_);
+        return;
+    }
+#elif defined(__linux__)
+    notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(notify_fd < 0 || inotify_add_watch(notify_fd, dir_, IN_CLOSE_WRITE | IN_MOVED_TO) < 0 ||
+            pipe(stop_pipe) != 0) {
+        printf("Could not watch %s.\n", dir_);
+        return;
+    }
+#else
+    printf("File watching is not supported on this platform.\n");
+    return;
+#endif
+    thread = std::thread([this] { run(); });
+}
+
+file_watcher::~file_watcher() {
+#ifdef _WIN32
+    if(thread.joinable()) {
+        SetEvent(stop_event);
+        thread.join();
+    }
+    for(HANDLE h : {dir_handle, stop_event}) {
+        if(h) {
+            CloseHandle(h);
+        }
+    }
+#elif defined(__linux__)
+    if(thread.joinable()) {
+        const char c = 0;
+        if(write(stop_pipe[1], &c, 1) != 1) {
+            std::terminate();
+        }
+        thread.join();
+    }
+    for(int fd : {notify_fd, stop_pipe[0], stop_pipe[1]}) {
+        if(fd >= 0) {
+            close(fd);
+        }
+    }
+#endif
+}
+
+std::vector<std::string> file_watcher::take_changes() {
+    std::lock_guard<std::mutex> lock(m);
+    std::vector<std::string> result(changes.begin(), changes.end());
+    changes.clear();
+    return result;
+}
+
+void file_watcher::report(std::string name) {
+    bool first;
+    {
+        std::lock_guard<std::mutex> lock(m);
+        first = changes.empty();
+        changes.insert(std::move(name));
+    }
+    // One event wakes the main loop, which then takes everything.
+    if(first && wakeup_event != 0) {
+        SDL_Event e;
+        SDL_memset(&e, 0, sizeof(e));
+        e.type = wakeup_event;
+        SDL_PushEvent(&e);
+    }
+}
+
+void file_watcher::run() {
+#ifdef _WIN32
+    alignas(DWORD) char buf[16384];
+    OVERLAPPED ov{};
+    ov.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    if(!ov.hEvent) {
+        return;
+    }
+    const HANDLE waits[2] = {ov.hEvent, stop_event};
+    while(true) {
+        ResetEvent(ov.hEvent);
+        if(!ReadDirectoryChangesW(dir_handle, buf, sizeof(buf), FALSE,
+                FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE, nullptr, &ov, nullptr)) {
+            break;
+        }
+        DWORD got = 0;
+        if(WaitForMultipleObjects(2, waits, FALSE, INFINITE) != WAIT_OBJECT_0) {
+            // Stopping. The buffer must not go away under a pending read.
+            CancelIo(dir_handle);
+            GetOverlappedResult(dir_handle, &ov, &got, TRUE);
+            break;
+        }
+        if(!GetOverlappedResult(dir_handle, &ov, &got, FALSE)) {
+            break;
+        }
+        // Zero means the changes did not fit and are lost.
+        const char *p = buf;
+        while(got > 0) {
+            const auto *info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(p);
+            if(info->Action == FILE_ACTION_MODIFIED || info->Action == FILE_ACTION_ADDED ||
+                    info->Action == FILE_ACTION_RENAMED_NEW_NAME) {
+                const int wlen = int(info->FileNameLength/sizeof(WCHAR));
+                const int len = WideCharToMultiByte(CP_UTF8, 0, info->FileName, wlen, nullptr, 0, nullptr, nullptr);
+                std::string name(size_t(len), '\0');
+                WideCharToMultiByte(CP_UTF8, 0, info->FileName, wlen, &name[0], len, nullptr, nullptr);
+                report(std::move(name));
+            }
+            if(info->NextEntryOffset == 0) {
+                break;
+            }
+            p += info->NextEntryOffset;
+        }
+    }
+    CloseHandle(ov.hEvent);
+#elif defined(__linux__)
+    alignas(inotify_event) char buf[4096];
+    pollfd fds[2] = {{notify_fd, POLLIN, 0}, {stop_pipe[0], POLLIN, 0}};
+    while(true) {
+        const int r = poll(fds, 2, -1);
+        if(r < 0 && errno == EINTR) {
+            continue;
+        }
+        if(r < 0 || (fds[1].revents & POLLIN)) {
+            break;
+        }
+        ssize_t got;
+        while((got = read(notify_fd, buf, sizeof(buf))) > 0) {
+            for(const char *p=buf; p<buf + got;) {
+                const auto *ev = reinterpret_cast<const inotify_event*>(p);
+                if(ev->len > 0) {
+                    report(ev->name);
+                }
+                p += sizeof(inotify_event) + ev->len;
+            }
+        }
+    }
+#endif
+}
@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include<SDL.h>
+#include<mutex>
+#include<set>
+#include<string>
+#include<thread>
+#include<vector>
+
+// Watches one directory, not recursively, for files that are written
+// or moved into place. Uses inotify on Linux and ReadDirectoryChangesW
+// on Windows, elsewhere it never reports anything. The watching runs
+// on a thread of its own, which pushes wakeup_event, if nonzero, when
+// there is something new to take.
+struct file_watcher {
+    file_watcher(const char *dir, Uint32 wakeup_event);
+    ~file_watcher();
+
+    file_watcher(const file_watcher &) = delete;
+    file_watcher& operator=(const file_watcher &) = delete;
+
+    bool active() const { return thread.joinable(); }
+
+    // Names relative to the watched directory, each at most once.
+    std::vector<std::string> take_changes();
+
+private:
+    void run();
+    void report(std::string name);
+
+    std::string dir;
+    Uint32 wakeup_event;
+    std::mutex m;
+    std::set<std::string> changes;
+    std::thread thread;
+#ifdef _WIN32
+    void *dir_handle = nullptr;
+    void *stop_event = nullptr;
+#else
+    int notify_fd = -1;
+    int stop_pipe[2] = {-1, -1};
+#endif
+};
@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#include"framearena.hpp"
+#include<algorithm>
+#include<cassert>
+
+linear_arena::linear_arena(size_t capacity) : block(capacity ? new unsigned char[capacity] : nullptr),
+        cap(capacity) {
+}
+
+void* linear_arena::allocate(size_t size, size_t align) {
+    // Blocks from new[] are aligned for any fundamental type.
+    assert(align <= alignof(std::max_align_t) && (align & (align - 1)) == 0);
+    const size_t start = (top + align - 1) & ~(align - 1);
+    if(start + size <= cap) {
+        top = start + size;
+        return block.get() + start;
+    }
+    overflow.emplace_back(new unsigned char[size]);
+    overflow_bytes += size + align;
+    return overflow.back().get();
+}
+
+void linear_arena::reset() {
+    if(overflow_bytes > 0) {
+        cap = std::max(2*cap, top + overflow_bytes);
+        block.reset(new unsigned char[cap]);
+        overflow.clear();
+        overflow_bytes = 0;
+        ++grow_count;
+    }
+    top = 0;
+}
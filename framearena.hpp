@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include<cstddef>
+#include<memory>
+#include<new>
+#include<type_traits>
+#include<utility>
+#include<vector>
+
+// Bump allocator for data that only lives until the next reset(),
+// which frees everything at once. Objects are never destroyed, so only
+// trivially destructible ones go in. If the block runs out the rest
+// comes from the heap and the next reset() grows the block to fit,
+// so a repeating workload stops touching the heap after one round.
+struct linear_arena {
+    explicit linear_arena(size_t capacity = 0);
+
+    linear_arena(const linear_arena &) = delete;
+    linear_arena& operator=(const linear_arena &) = delete;
+
+    void* allocate(size_t size, size_t align);
+
+    template<typename T, typename... Args>
+    T* create(Args&&... args) {
+        static_assert(std::is_trivially_destructible<T>::value, "Arena objects are never destroyed.");
+        return new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    void reset();
+
+    size_t capacity() const { return cap; }
+    size_t used() const { return top + overflow_bytes; }
+    // Times the block has been grown.
+    size_t grows() const { return grow_count; }
+
+private:
+    std::unique_ptr<unsigned char[]> block;
+    size_t cap;
+    size_t top = 0;
+    std::vector<std::unique_ptr<unsigned char[]>> overflow;
+    size_t overflow_bytes = 0;
+    size_t grow_count = 0;
+};
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#include"framepacer.hpp"
+#include<algorithm>
+
+double display_refresh_rate(SDL_Window *win) {
+    SDL_DisplayMode mode;
+    const int display = SDL_GetWindowDisplayIndex(win);
+    if(display >= 0 && SDL_GetCurrentDisplayMode(display, &mode) == 0 && mode.refresh_rate > 0) {
+        return mode.refresh_rate;
+    }
+    return 60;
+}
+
+framepacer::framepacer(double target_hz) : freq(SDL_GetPerformanceFrequency()) {
+    spin_margin = freq/500;
+    set_target(target_hz);
+}
+
+void framepacer::set_target(double target_hz) {
+    hz = target_hz;
+    period = Uint64(freq/hz);
+    next_deadline = SDL_GetPerformanceCounter() + period;
+}
+
+void framepacer::wait() {
+    const Uint64 min_margin = freq/2000;
+    const Uint64 max_margin = freq/200;
+    auto now = SDL_GetPerformanceCounter();
+    if(now < next_deadline && next_deadline - now > spin_margin) {
+        const Uint64 sleep_ticks = next_deadline - now - spin_margin;
+        const Uint32 sleep_ms = Uint32(sleep_ticks*1000/freq);
+        if(sleep_ms > 0) {
+            SDL_Delay(sleep_ms);
+            const auto after = SDL_GetPerformanceCounter();
+            const Uint64 requested = sleep_ms*freq/1000;
+            const Uint64 slept = after - now;
+            const Uint64 oversleep = slept > requested ? slept - requested : 0;
+            // Keep some headroom over the typical oversleep.
+            spin_margin = std::clamp((7*spin_margin + 2*oversleep)/8, min_margin, max_margin);
+            now = after;
+        }
+    }
+    while(now < next_deadline) {
+        now = SDL_GetPerformanceCounter();
+    }
+    next_deadline += period;
+    // If we fell more than a frame behind, do not try to catch up
+    // with a burst of short frames.
+    if(now > next_deadline) {
+        next_deadline = now + period;
+    }
+}
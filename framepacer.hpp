@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include<SDL.h>
+
+// Refresh rate of the display the window is on, or 60 if unknown.
+double display_refresh_rate(SDL_Window *win);
+
+// Paces frames to a fixed rate without vsync. Sleeps with SDL_Delay
+// until shortly before the deadline and spins for the rest, because
+// SDL_Delay alone can oversleep by a millisecond or more.
+struct framepacer {
+    explicit framepacer(double target_hz);
+
+    void set_target(double hz);
+    double target_hz() const { return hz; }
+
+    // Blocks until the start of the next frame period.
+    void wait();
+
+private:
+    double hz;
+    Uint64 freq;
+    Uint64 period;
+    Uint64 next_deadline;
+    // How early to stop sleeping, adapted to the measured oversleep.
+    Uint64 spin_margin;
+};
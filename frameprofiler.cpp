@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#include"frameprofiler.hpp"
+#include"allocstats.hpp"
+#include<algorithm>
+#include<cstdio>
+#include<vector>
+
+namespace {
+
+const char *phase_names[NUM_PHASES] = {"events", "update", "render", "present", "sleep"};
+const SDL_Color phase_colors[NUM_PHASES] = {
+    {255, 220, 0, 255},
+    {80, 220, 80, 255},
+    {0, 200, 255, 255},
+    {255, 60, 60, 255},
+    {90, 90, 90, 255},
+};
+
+const int overlay_bars = 240;
+const int overlay_height = 100;
+const double overlay_ms = 33.3;
+
+double percentile(std::vector<double> &sorted, double p) {
+    if(sorted.empty()) {
+        return 0;
+    }
+    const size_t i = std::min(sorted.size() - 1, size_t(p*(sorted.size() - 1) + 0.5));
+    return sorted[i];
+}
+
+}
+
+frameprofiler::frameprofiler() : samples(capacity), current{}, ms_per_tick(1000.0/SDL_GetPerformanceFrequency()) {
+}
+
+void frameprofiler::begin_frame() {
+    current = frame_sample{};
+    allocs_start = heap_allocations();
+    frame_start = phase_start = SDL_GetPerformanceCounter();
+}
+
+void frameprofiler::end_phase(frame_phase p) {
+    const auto now = SDL_GetPerformanceCounter();
+    current.phase_ticks[p] += now - phase_start;
+    phase_start = now;
+}
+
+void frameprofiler::end_frame() {
+    current.total_ticks = SDL_GetPerformanceCounter() - frame_start;
+    current.allocs = heap_allocations() - allocs_start;
+    samples[next] = current;
+    ++total_frames;
+    next = (next + 1) % capacity;
+    count = std::min(count + 1, capacity);
+}
+
+const frame_sample& frameprofiler::frame(size_t i) const {
+    return samples[(next + capacity - count + i) % capacity];
+}
+
+frame_stats frameprofiler::stats() const {
+    std::vector<double> totals;
+    totals.reserve(count);
+    size_t steady_allocs = 0;
+    // Stored frame i is overall frame total_frames - count + i.
+    const size_t first_steady = total_frames - count < warmup_frames ? warmup_frames - (total_frames - count) : 0;
+    for(size_t i=0; i<count; ++i) {
+        totals.push_back(to_ms(frame(i).total_ticks));
+        if(i >= first_steady) {
+            steady_allocs = std::max(steady_allocs, frame(i).allocs);
+        }
+    }
+    std::sort(totals.begin(), totals.end());
+    frame_stats s;
+    s.frames = count;
+    s.p50_ms = percentile(totals, 0.5);
+    s.p99_ms = percentile(totals, 0.99);
+    s.max_ms = totals.empty() ? 0 : totals.back();
+    s.steady_allocs = steady_allocs;
+    return s;
+}
+
+void frameprofiler::draw_overlay(SDL_Renderer *rend) const {
+    const int bars = int(std::min(count, size_t(overlay_bars)));
+    const double px_per_ms = overlay_height/overlay_ms;
+    SDL_Rect rects[NUM_PHASES][overlay_bars];
+    for(int b=0; b<bars; ++b) {
+        const auto &f = frame(count - bars + b);
+        int y = overlay_height;
+        for(int p=0; p<NUM_PHASES; ++p) {
+            const int h = std::min(y, int(to_ms(f.phase_ticks[p])*px_per_ms + 0.5));
+            y -= h;
+            rects[p][b] = SDL_Rect{2*b, y, 2, h};
+        }
+    }
+    SDL_SetRenderDrawBlendMode(rend, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(rend, 0, 0, 0, 160);
+    const SDL_Rect background{0, 0, 2*overlay_bars, overlay_height};
+    SDL_RenderFillRect(rend, &background);
+    for(int p=0; p<NUM_PHASES; ++p) {
+        const auto &c = phase_colors[p];
+        SDL_SetRenderDrawColor(rend, c.r, c.g, c.b, c.a);
+        SDL_RenderFillRects(rend, rects[p], bars);
+    }
+    // 60 Hz budget line.
+    const int budget_y = overlay_height - int(1000.0/60*px_per_ms);
+    SDL_SetRenderDrawColor(rend, 255, 255, 255, 255);
+    SDL_RenderDrawLine(rend, 0, budget_y, 2*overlay_bars, budget_y);
+    SDL_SetRenderDrawBlendMode(rend, SDL_BLENDMODE_NONE);
+}
+
+bool frameprofiler::write_csv(const char *fname) const {
+    FILE *f = fopen(fname, "w");
+    if(!f) {
+        printf("Could not open %s for writing.\n", fname);
+        return false;
+    }
+    fprintf(f, "frame");
+    for(int p=0; p<NUM_PHASES; ++p) {
+        fprintf(f, ",%s_ms", phase_names[p]);
+    }
+    fprintf(f, ",total_ms,allocs\n");
+    for(size_t i=0; i<count; ++i) {
+        const auto &s = frame(i);
+        fprintf(f, "%d", int(i));
+        for(int p=0; p<NUM_PHASES; ++p) {
+            fprintf(f, ",%.3f", to_ms(s.phase_ticks[p]));
+        }
+        fprintf(f, ",%.3f,%d\n", to_ms(s.total_ticks), int(s.allocs));
+    }
+    const auto st = stats();
+    fprintf(f, "# frames=%d p50_ms=%.3f p99_ms=%.3f max_ms=%.3f steady_allocs=%d\n",
+            int(st.frames), st.p50_ms, st.p99_ms, st.max_ms, int(st.steady_allocs));
+    return fclose(f) == 0;
+}
@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include<SDL.h>
+#include<cstddef>
+#include<vector>
+
+enum frame_phase {
+    PHASE_EVENTS,
+    PHASE_UPDATE,
+    PHASE_RENDER,
+    PHASE_PRESENT,
+    PHASE_SLEEP,
+    NUM_PHASES,
+};
+
+struct frame_sample {
+    Uint64 phase_ticks[NUM_PHASES];
+    Uint64 total_ticks;
+    // Heap allocations on any thread during the frame.
+    size_t allocs;
+};
+
+struct frame_stats {
+    size_t frames;
+    double p50_ms;
+    double p99_ms;
+    double max_ms;
+    // Most allocations in one frame once warmed up, which should be 0.
+    size_t steady_allocs;
+};
+
+// Per phase frame timings of the most recent frames, measured with
+// the performance counter, and how much they allocated.
+struct frameprofiler {
+    static const size_t capacity = 8192;
+    // Frames that fill caches and arenas, left out of steady_allocs.
+    static const size_t warmup_frames = 60;
+
+    bool overlay_visible = false;
+
+    frameprofiler();
+
+    void begin_frame();
+    // Everything since the previous end_phase (or begin_frame) is
+    // accounted to the given phase.
+    void end_phase(frame_phase p);
+    void end_frame();
+
+    size_t num_frames() const { return count; }
+    // i = 0 is the oldest stored frame.
+    const frame_sample& frame(size_t i) const;
+    double to_ms(Uint64 ticks) const { return ticks*ms_per_tick; }
+
+    frame_stats stats() const;
+    void draw_overlay(SDL_Renderer *rend) const;
+    bool write_csv(const char *fname) const;
+
+private:
+    std::vector<frame_sample> samples;
+    size_t next = 0;
+    size_t count = 0;
+    frame_sample current;
+    Uint64 frame_start = 0;
+    Uint64 phase_start = 0;
+    size_t allocs_start = 0;
+    size_t total_frames = 0;
+    double ms_per_tick;
+};
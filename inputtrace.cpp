@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#include"inputtrace.hpp"
+#include<algorithm>
+#include<cstdio>
+
+namespace {
+
+const char* event_name(Uint32 type) {
+    switch(type) {
+    case SDL_KEYDOWN:
+        return "key";
+    case SDL_MOUSEBUTTONDOWN:
+        return "mouse button";
+    case SDL_JOYBUTTONDOWN:
+        return "joystick button";
+    default:
+        return "input";
+    }
+}
+
+void print_latency(const char *label, std::vector<double> &ms) {
+    if(ms.empty()) {
+        return;
+    }
+    std::sort(ms.begin(), ms.end());
+    printf("%s latency over %d events: p50 %.2f ms, max %.2f ms.\n",
+            label, int(ms.size()), ms[ms.size()/2], ms.back());
+}
+
+}
+
+input_tracer::input_tracer(bool enabled) : on(enabled), start_ticks(SDL_GetPerformanceCounter()),
+        start_ms(SDL_GetTicks()), freq(SDL_GetPerformanceFrequency()) {
+    if(on) {
+        traces.reserve(capacity);
+    }
+}
+
+Uint32 input_tracer::input(const SDL_Event &e) {
+    if(!on || traces.size() == capacity) {
+        return 0;
+    }
+    const Uint64 now = SDL_GetPerformanceCounter();
+    // Event timestamps are SDL_GetTicks() values, move them onto the
+    // performance counter's time line. Never later than the poll.
+    const Sint64 since_start = Sint64(Sint32(e.common.timestamp - start_ms))*Sint64(freq)/1000;
+    const Uint64 event_ticks = std::min(now, Uint64(Sint64(start_ticks) + since_start));
+    traces.push_back(input_trace{e.type, event_ticks, now, 0, 0});
+    return Uint32(traces.size());
+}
+
+void input_tracer::add_audio(const audio_trace &t) {
+    if(t.id > 0 && t.id <= traces.size()) {
+        traces[t.id - 1].audio_ticks = t.ticks;
+    }
+}
+
+void input_tracer::presented() {
+    if(!on) {
+        return;
+    }
+    const Uint64 now = SDL_GetPerformanceCounter();
+    for(; unpresented<traces.size(); ++unpresented) {
+        traces[unpresented].present_ticks = now;
+    }
+}
+
+double input_tracer::to_us(Uint64 ticks) const {
+    return double(Sint64(ticks - start_ticks))*1e6/freq;
+}
+
+bool input_tracer::write_json(const char *fname) const {
+    FILE *f = fopen(fname, "w");
+    if(!f) {
+        printf("Could not open %s for writing.\n", fname);
+        return false;
+    }
+    fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    fprintf(f, "{\"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"name\": \"thread_name\", \"args\": {\"name\": \"input\"}},\n");
+    fprintf(f, "{\"ph\": \"M\", \"pid\": 1, \"tid\": 2, \"name\": \"thread_name\", \"args\": {\"name\": \"video\"}},\n");
+    fprintf(f, "{\"ph\": \"M\", \"pid\": 1, \"tid\": 3, \"name\": \"thread_name\", \"args\": {\"name\": \"audio\"}}");
+    for(size_t i=0; i<traces.size(); ++i) {
+        const auto &t = traces[i];
+        const double ev = to_us(t.event_ticks);
+        fprintf(f, ",\n{\"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"name\": \"%s to poll\", \"ts\": %.1f, \"dur\": %.1f, "
+                "\"args\": {\"id\": %d}}",
+                event_name(t.type), ev, to_us(t.poll_ticks) - ev, int(i + 1));
+        if(t.present_ticks) {
+            fprintf(f, ",\n{\"ph\": \"X\", \"pid\": 1, \"tid\": 2, \"name\": \"%s to present\", \"ts\": %.1f, "
+                    "\"dur\": %.1f, \"args\": {\"id\": %d}}",
+                    event_name(t.type), ev, to_us(t.present_ticks) - ev, int(i + 1));
+        }
+        if(t.audio_ticks) {
+            fprintf(f, ",\n{\"ph\": \"X\", \"pid\": 1, \"tid\": 3, \"name\": \"%s to audio callback\", \"ts\": %.1f, "
+                    "\"dur\": %.1f, \"args\": {\"id\": %d}}",
+                    event_name(t.type), ev, to_us(t.audio_ticks) - ev, int(i + 1));
+        }
+    }
+    fprintf(f, "\n]}\n");
+    return fclose(f) == 0;
+}
+
+void input_tracer::print_summary() const {
+    std::vector<double> video, audio;
+    for(const auto &t : traces) {
+        if(t.present_ticks) {
+            video.push_back((t.present_ticks - t.event_ticks)*1000.0/freq);
+        }
+        if(t.audio_ticks) {
+            audio.push_back((t.audio_ticks - t.event_ticks)*1000.0/freq);
+        }
+    }
+    print_latency("Input to present", video);
+    print_latency("Input to audio callback", audio);
+}
@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include<SDL.h>
+#include<cstddef>
+#include<vector>
+
+// Sent from the audio thread when it starts mixing a traced sound.
+struct audio_trace {
+    Uint32 id;
+    Uint64 ticks;
+};
+
+// Times of one input event on its way to the screen and speakers, in
+// performance counter ticks. Zero means it did not happen.
+struct input_trace {
+    Uint32 type;
+    Uint64 event_ticks;
+    Uint64 poll_ticks;
+    Uint64 audio_ticks;
+    Uint64 present_ticks;
+};
+
+// Tags input events with ids and follows them from the event's own
+// timestamp through polling, the audio callback that first mixes the
+// sound they trigger and the present of the frame that handled them.
+// SDL event timestamps only have millisecond resolution. Main thread
+// only, audio times come in through add_audio.
+struct input_tracer {
+    static const size_t capacity = 1 << 16;
+
+    explicit input_tracer(bool enabled);
+
+    bool enabled() const { return on; }
+
+    // Returns the id of the event, or 0 if it is not traced.
+    Uint32 input(const SDL_Event &e);
+    void add_audio(const audio_trace &t);
+    // Every event since the last present is on screen now.
+    void presented();
+
+    // Chrome trace event format, which Perfetto also reads.
+    bool write_json(const char *fname) const;
+    void print_summary() const;
+
+private:
+    double to_us(Uint64 ticks) const;
+
+    bool on;
+    std::vector<input_trace> traces;
+    size_t unpresented = 0;
+    Uint64 start_ticks;
+    Uint32 start_ms;
+    Uint64 freq;
+};
@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#include"loader.hpp"
+#include"pcmcache.hpp"
+#include"workerpool.hpp"
+#include<SDL_image.h>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<cassert>
+
+SDL_Surface* unpack_image(const char* fname) {
+    SDL_Surface *s = IMG_Load(fname);
+    if(!s) {
+        printf("IMG_Load %s: %s\n", fname, IMG_GetError());
+        std::abort();
+    }
+    return s;
+}
+
+Mix_Chunk* unpack_wav(const std::vector<Uint8> &bytes) {
+    Mix_Chunk *res = Mix_LoadWAV_RW(SDL_RWFromConstMem(bytes.data(), int(bytes.size())), 1);
+    assert(res);
+    return res;
+}
+
+Mix_Chunk* load_sound(const std::vector<Uint8> &bytes, const pcm_cache *cache) {
+    int freq;
+    Uint16 format;
+    int channels;
+    if(!Mix_QuerySpec(&freq, &format, &channels) || format != AUDIO_S16SYS) {
+        return Mix_LoadWAV_RW(SDL_RWFromConstMem(bytes.data(), int(bytes.size())), 1);
+    }
+    const pcm_format out{freq, channels};
+    const uint64_t key = cache ? content_hash(bytes.data(), bytes.size()) : 0;
+    std::vector<Sint16> pcm;
+    if(!cache || !cache->load(key, out, pcm)) {
+        if(!convert_sound(bytes.data(), bytes.size(), out, pcm)) {
+            return Mix_LoadWAV_RW(SDL_RWFromConstMem(bytes.data(), int(bytes.size())), 1);
+        }
+        if(cache) {
+            cache->store(key, out, pcm);
+        }
+    }
+    // Built by hand since Mix_QuickLoad_RAW does not take ownership.
+    // Mix_FreeChunk releases abuf with SDL_free when allocated is set.
+    const size_t len = pcm.size()*sizeof(Sint16);
+    auto *chunk = static_cast<Mix_Chunk*>(SDL_malloc(sizeof(Mix_Chunk)));
+    auto *buf = static_cast<Uint8*>(SDL_malloc(len ? len : 1));
+    if(!chunk || !buf) {
+        SDL_free(chunk);
+        SDL_free(buf);
+        return nullptr;
+    }
+    memcpy(buf, pcm.data(), len);
+    chunk->allocated = 1;
+    chunk->abuf = buf;
+    chunk->alen = Uint32(len);
+    chunk->volume = MIX_MAX_VOLUME;
+    return chunk;
+}
+
+uint64_t content_hash(const Uint8 *data, size_t size) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for(size_t i=0; i<size; ++i) {
+        h = (h ^ data[i])*0x100000001b3ull;
+    }
+    return h;
+}
+
+bool try_read_file(const char *fname, std::vector<Uint8> &bytes) {
+    SDL_RWops *f = SDL_RWFromFile(fname, "rb");
+    if(!f) {
+        printf("Could not open %s: %s\n", fname, SDL_GetError());
+        return false;
+    }
+    const Sint64 size = SDL_RWsize(f);
+    if(size < 0) {
+        printf("Could not get the size of %s: %s\n", fname, SDL_GetError());
+        SDL_RWclose(f);
+        return false;
+    }
+    bytes.resize(size_t(size));
+    const size_t got = SDL_RWread(f, bytes.data(), 1, bytes.size());
+    SDL_RWclose(f);
+    if(got != bytes.size()) {
+        printf("Could not read %s.\n", fname);
+        return false;
+    }
+    return true;
+}
+
+std::vector<Uint8> read_file(const char *fname) {
+    std::vector<Uint8> bytes;
+    if(!try_read_file(fname, bytes)) {
+        std::abort();
+    }
+    return bytes;
+}
+
+decoded_assets::decoded_assets(workerpool &pool,
+        const std::vector<const char*> &image_files,
+        const std::vector<const char*> &sound_files,
+        double stream_seconds,
+        const pcm_cache *cache) :
+        images(image_files.size(), nullptr),
+        sounds(sound_files.size(), nullptr),
+        encoded(sound_files.size()) {
+    // Every task writes to its own preallocated slot so the results
+    // need no locking.
+    for(size_t i=0; i<sound_files.size(); ++i) {
+        pool.submit([this, i, &sound_files, stream_seconds, cache] {
+            auto bytes = read_file(sound_files[i]);
+            if(vorbis_seconds(bytes.data(), bytes.size()) >= stream_seconds) {
+                encoded[i] = std::move(bytes);
+            } else {
+                sounds[i] = load_sound(bytes, cache);
+                if(!sounds[i]) {
+                    printf("Could not decode %s: %s\n", sound_files[i], Mix_GetError());
+                    std::abort();
+                }
+            }
+        });
+    }
+    for(size_t i=0; i<image_files.size(); ++i) {
+        pool.submit([this, i, &image_files] { images[i] = unpack_image(image_files[i]); });
+    }
+    pool.wait();
+}
+
+decoded_assets::~decoded_assets() {
+    release_images();
+    for(auto *c : sounds) {
+        Mix_FreeChunk(c);
+    }
+}
+
+void decoded_assets::release_images() {
+    for(auto *s : images) {
+        SDL_FreeSurface(s);
+    }
+    images.clear();
+}
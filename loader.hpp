@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include<SDL.h>
+#include<SDL_mixer.h>
+#include"soundstream.hpp"
+#include<cstdint>
+#include<vector>
+
+struct workerpool;
+struct pcm_cache;
+
+// Output format of the mixer. Mix_LoadWAV converts every sound to it.
+const int mix_frequency = 44100;
+const Uint16 mix_format = MIX_DEFAULT_FORMAT;
+const int mix_channels = 2;
+
+SDL_Surface* unpack_image(const char* fname);
+Mix_Chunk* unpack_wav(const std::vector<Uint8> &bytes);
+// Converts a WAV or Vorbis sound to the opened mixer's format with
+// the sinc resampler, or takes the conversion from the cache. Falls
+// back to SDL_mixer's own conversion for formats other than 16 bit.
+// Returns null if the sound can not be decoded.
+Mix_Chunk* load_sound(const std::vector<Uint8> &bytes, const pcm_cache *cache);
+// FNV-1a of the data, for telling versions of a file apart.
+uint64_t content_hash(const Uint8 *data, size_t size);
+// Prints the reason and returns false if the file can not be read.
+bool try_read_file(const char *fname, std::vector<Uint8> &bytes);
+std::vector<Uint8> read_file(const char *fname);
+
+// Decoded but not yet uploaded assets. Decoding happens in parallel
+// on the given pool, the constructor returns once all of it is done.
+// Vorbis sounds at least stream_seconds long are kept encoded so
+// they can be streamed, those have a null entry in sounds. The others
+// go through load_sound.
+struct decoded_assets {
+    std::vector<SDL_Surface*> images;
+    std::vector<Mix_Chunk*> sounds;
+    std::vector<std::vector<Uint8>> encoded;
+
+    decoded_assets(workerpool &pool,
+            const std::vector<const char*> &image_files,
+            const std::vector<const char*> &sound_files,
+            double stream_seconds = stream_min_seconds,
+            const pcm_cache *cache = nullptr);
+    ~decoded_assets();
+
+    decoded_assets(const decoded_assets &) = delete;
+    decoded_assets& operator=(const decoded_assets &) = delete;
+
+    // Image data is not needed after it has been uploaded to the GPU.
+    void release_images();
+
+    sound_asset sound(size_t i) const {
+        return sound_asset{sounds[i], encoded_sound{encoded[i].data(), encoded[i].size()}};
+    }
+};
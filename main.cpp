@@ -4,19 +4,57 @@
 #include<SDL.h>
 #include<SDL_image.h>
 #include<SDL_mixer.h>
+#include"spritebatch.hpp"
+#include"atlas.hpp"
+#include"loader.hpp"
+#include"workerpool.hpp"
+#include"assetpack.hpp"
+#include"audio.hpp"
+#include"frameprofiler.hpp"
+#include"framepacer.hpp"
+#include"entities.hpp"
+#include"simulation.hpp"
+#include"resourcemanager.hpp"
+#include"filewatcher.hpp"
+#include"inputtrace.hpp"
+#include"rendercapture.hpp"
+#include"driverconfig.hpp"
+#include"allocstats.hpp"
+#include"pcmcache.hpp"
+#include"visibility.hpp"
 #include<cstdio>
 #include<cstdlib>
+#include<cstring>
 #include<cassert>
-#include<math.h>
+#include<algorithm>
+#include<condition_variable>
+#include<memory>
+#include<mutex>
+#include<string>
+#include<thread>
+#include<vector>
 
 const int SCREEN_WIDTH = 1920/2;
 const int SCREEN_HEIGHT = 1080/2;
-const uint32_t FTIME = (1000/60);
 
 // For simplicity.
 const int texw = 100;
 const int texh = 100;
 
+// Length of one full trip along the motion path.
+const double cycle_seconds = 2.0;
+const double default_sim_rate = 60;
+
+const int default_entities = 3;
+const int max_entities = 1000000;
+const int max_windows = 16;
+
+#if defined(_MSC_VER)
+const Uint32 window_flags = 0;
+#else
+const Uint32 window_flags = SDL_WINDOW_OPENGL;
+#endif
+
 const char blue_file[] = "res/blue.png";
 const char green_file[] = "res/green.jpg";
 const char red_file[] = "res/red.tif";
@@ -24,158 +62,1158 @@ const char shoot_file[] = "res/shoot.wav";
 const char startup_file[] = "res/startup.ogg";
 const char explode_file[] = "res/explode.wav";
 
-SDL_Texture* unpack_image(SDL_Renderer *rend, const char* fname) {
-    SDL_Surface *s = IMG_Load(fname);
-    if(!s) {
-        printf("IMG_Load %s: %s\n", fname, IMG_GetError());
-        std::abort();
+const std::vector<const char*> image_files{blue_file, red_file, green_file};
+const std::vector<const char*> sound_files{startup_file, shoot_file, explode_file};
+
+struct app_options {
+    const char *pack_file = nullptr;
+    audio_backend audio = audio_backend::mixer;
+    // Zero means the backend's default.
+    int audio_buffer = 0;
+    bool profile_overlay = false;
+    const char *profile_csv = nullptr;
+    // Frame rate when there is no vsync. Zero means the display's rate.
+    double target_fps = 0;
+    // Render driver name, "all" is only valid with bench_frames or
+    // replay_file. "auto" uses the driver a startup probe found to be
+    // the fastest, probing only if it is not known yet, and "probe"
+    // always probes.
+    const char *driver = nullptr;
+    int bench_frames = 0;
+    // Bench and replay on shown windows instead of hidden ones.
+    bool bench_visible = false;
+    double sim_rate = default_sim_rate;
+    int entities = default_entities;
+    // Benchmark every power of ten from 10 to max_entities.
+    bool entity_sweep = false;
+    // Skip drawing when the window is hidden or nothing has changed,
+    // and block waiting for events instead.
+    bool power_save = false;
+    // Vorbis sounds at least this long are streamed when decoding files.
+    double stream_min = stream_min_seconds;
+    // Keep sounds converted to the device format on disk.
+    bool pcm_cache = true;
+    // Reload changed files in res/ while running.
+    bool watch = false;
+    // Input latency trace output.
+    const char *trace_file = nullptr;
+    // Render command recording to write, or to replay instead of running.
+    const char *record_file = nullptr;
+    const char *replay_file = nullptr;
+    // More than one opens a window per display, each with a render thread.
+    int windows = 1;
+    motion_eval motion = motion_eval::approx;
+};
+
+enum sound_id {
+    SOUND_STARTUP,
+    SOUND_SHOOT,
+    SOUND_EXPLODE,
+};
+
+// Either a prebaked atlas and sounds, from a mapped pack or decoded
+// once for several renderers, or the asset files loaded in the
+// background by a resource manager.
+struct resources {
+    std::unique_ptr<texture_atlas> atlas;
+    std::vector<sound_asset> preloaded_sounds;
+    std::unique_ptr<resource_manager> manager;
+    std::vector<resource_handle> image_handles;
+    std::vector<resource_handle> sound_handles;
+    // Indexed by sprite id, refreshed by update().
+    std::vector<sprite> sprites;
+
+    // The pack must stay mapped.
+    resources(SDL_Renderer *rend, const asset_pack &pack) :
+            atlas(std::make_unique<texture_atlas>(rend, pack.page_pixels(), pack.sprite_layout(image_files))),
+            sprites(atlas->sprites) {
+        for(const auto *f : sound_files) {
+            preloaded_sounds.push_back(pack.sound(f));
+        }
     }
-    SDL_Texture *tex = SDL_CreateTextureFromSurface(rend, s);
-    SDL_FreeSurface(s);
-    return tex;
-}
 
-Mix_Chunk* unpack_wav(const char *fname) {
-    Mix_Chunk *res = Mix_LoadWAV(fname);
-    assert(res);
-    return res;
-}
+    // The pixels and sounds must outlive the resources.
+    resources(SDL_Renderer *rend, const std::vector<atlas_page_pixels> &pages, const atlas_layout &layout,
+            const std::vector<sound_asset> &sounds) :
+            atlas(std::make_unique<texture_atlas>(rend, pages, layout)),
+            preloaded_sounds(sounds),
+            sprites(atlas->sprites) {
+    }
 
-template<typename T>
-T min(const T &t1, const T &t2) {
-   return t1 < t2 ? t1 : t2;
-}
+    // The cache may be null, as may the audio if nothing is played.
+    resources(SDL_Renderer *rend, workerpool &pool, double stream_seconds, const pcm_cache *cache,
+            audiocontrol *audio) :
+            manager(std::make_unique<resource_manager>(rend, pool, stream_seconds, cache, audio)) {
+        for(const auto *f : image_files) {
+            image_handles.push_back(manager->texture(f));
+        }
+        for(const auto *f : sound_files) {
+            sound_handles.push_back(manager->sound(f));
+        }
+        update();
+    }
+
+    // Returns true if something finished loading.
+    bool update() {
+        if(!manager) {
+            return false;
+        }
+        const size_t was_loading = manager->loading();
+        manager->update();
+        sprites.clear();
+        for(const auto &h : image_handles) {
+            sprites.push_back(manager->get_sprite(h));
+        }
+        return manager->loading() != was_loading;
+    }
 
-struct audiocontrol {
-    SDL_mutex *m;
-    SDL_AudioDeviceID dev;
-    Uint8 *sample;
-    int sample_size;
-    int played_bytes;
+    bool ready() const {
+        return !manager || manager->loading() == 0;
+    }
 
-    audiocontrol() : dev(0), sample(nullptr), sample_size(0), played_bytes(0) {
-        m = SDL_CreateMutex();
+    // Only assets loaded from files can be reloaded.
+    void reload(const char *path) {
+        if(manager) {
+            manager->reload(path);
+        }
     }
 
-    ~audiocontrol() {
-        if(dev) {
-            SDL_CloseAudioDevice(dev);
+    void finish_loading() {
+        if(manager) {
+            manager->finish();
+            update();
         }
     }
 
-    void play_sample(Mix_Chunk *sample) {
-        Mix_PlayChannel(-1, sample, 0);
+    sound_asset sound(sound_id id) {
+        return manager ? manager->get_sound(sound_handles[id]) : preloaded_sounds[id];
     }
+};
+
+// Where resources come from: a mapped asset pack if one was given
+// and is usable, otherwise the files in res/.
+struct asset_source {
+    workerpool &pool;
+    double stream_seconds;
+    asset_pack pack;
+    bool from_pack = false;
+    // Only used when loading the files.
+    std::unique_ptr<pcm_cache> cache;
 
-    void produce(Uint8 *stream, int len) {
-        SDL_LockMutex(m);
-        int written_bytes = 0;
-        if(played_bytes < sample_size) {
-            written_bytes = min(len, sample_size - played_bytes);
-            SDL_memmove(stream, sample, written_bytes);
-            played_bytes += written_bytes;
+    asset_source(workerpool &pool_, const char *pack_file, double stream_seconds_, bool use_cache) :
+            pool(pool_), stream_seconds(stream_seconds_) {
+        if(use_cache) {
+            cache = std::make_unique<pcm_cache>();
         }
-        if(written_bytes < len) {
-            SDL_memset(stream + written_bytes, 0, len - written_bytes);
+        if(pack_file && pack.load(pack_file) && pack.contains(image_files, sound_files) &&
+                pack.up_to_date(image_files, sound_files)) {
+            from_pack = true;
+            return;
+        }
+        if(pack_file) {
+            printf("Falling back to loading the asset files.\n");
+        }
+    }
+
+    // Can be called many times, once per renderer. Loaded sounds are
+    // kept while the audio plays them.
+    std::unique_ptr<resources> upload(SDL_Renderer *rend, audiocontrol *audio = nullptr) {
+        if(from_pack) {
+            return std::make_unique<resources>(rend, pack);
         }
-        SDL_UnlockMutex(m);
+        return std::make_unique<resources>(rend, pool, stream_seconds, cache.get(), audio);
     }
 };
 
-struct resources {
-    SDL_Texture*blue_tex;
-    SDL_Texture*red_tex;
-    SDL_Texture*green_tex;
-
-    Mix_Chunk* startup_sound;
-    Mix_Chunk* shoot_sound;
-    Mix_Chunk* explode_sound;
-
-    resources(SDL_Renderer *rend) : blue_tex(unpack_image(rend, blue_file)),
-            red_tex(unpack_image(rend, red_file)),
-            green_tex(unpack_image(rend, green_file)) {
-        assert(blue_tex);
-        assert(red_tex);
-        assert(green_tex);
-        startup_sound = unpack_wav(startup_file);
-        shoot_sound = unpack_wav(shoot_file);
-        explode_sound = unpack_wav(explode_file);
-    }
-
-    ~resources() {
-        Mix_FreeChunk(explode_sound);
-        Mix_FreeChunk(shoot_sound);
-        Mix_FreeChunk(startup_sound);
+// Assets decoded and composed into atlas pages once and kept in
+// memory, so that each of several renderers only uploads them.
+struct shared_assets {
+    std::unique_ptr<decoded_assets> decoded;
+    std::vector<SDL_Surface*> surfaces;
+    std::vector<atlas_page_pixels> pages;
+    atlas_layout layout;
+    std::vector<sound_asset> sounds;
+
+    explicit shared_assets(asset_source &source) {
+        if(source.from_pack) {
+            pages = source.pack.page_pixels();
+            layout = source.pack.sprite_layout(image_files);
+            for(const auto *f : sound_files) {
+                sounds.push_back(source.pack.sound(f));
+            }
+            return;
+        }
+        decoded = std::make_unique<decoded_assets>(source.pool, image_files, sound_files, source.stream_seconds,
+                source.cache.get());
+        surfaces = compose_pages(decoded->images, atlas_max_size, SDL_PIXELFORMAT_ARGB8888, layout);
+        decoded->release_images();
+        for(const auto *s : surfaces) {
+            pages.push_back(atlas_page_pixels{s->format->format, s->w, s->h, s->pitch, s->pixels});
+        }
+        for(size_t i=0; i<sound_files.size(); ++i) {
+            sounds.push_back(decoded->sound(i));
+        }
+    }
+
+    ~shared_assets() {
+        for(auto *s : surfaces) {
+            SDL_FreeSurface(s);
+        }
+    }
+
+    shared_assets(const shared_assets &) = delete;
+    shared_assets& operator=(const shared_assets &) = delete;
+
+    std::unique_ptr<resources> upload(SDL_Renderer *rend) const {
+        return std::make_unique<resources>(rend, pages, layout, sounds);
     }
 };
 
+const motion_params scene_motion{
+    float(SCREEN_WIDTH/2 - texw/2),
+    float(SCREEN_HEIGHT/2 - texh/2),
+    float(SCREEN_WIDTH*0.4),
+    float(SCREEN_HEIGHT*0.4),
+};
 
-void audiocallback(void *data, Uint8* stream, int len) {
-    auto control = reinterpret_cast<audiocontrol*>(data);
-    control->produce(stream, len);
+motion_params scene_motion_for(const app_options &opts) {
+    motion_params m = scene_motion;
+    m.eval = opts.motion;
+    return m;
 }
 
-void draw_single(SDL_Renderer *rend, SDL_Texture *tex, const double ratio) {
-    SDL_Rect r;
-    int centerx = SCREEN_WIDTH/2;
-    int centery = SCREEN_HEIGHT/2;
-    r.x = int(centerx - texw/2 + SCREEN_WIDTH*0.4*sin(2*M_PI*ratio));
-    r.y = int(centery - texh/2 + SCREEN_HEIGHT*0.4*cos(2*2*M_PI*(ratio) + M_PI/2));
-    r.w = texw;
-    r.h = texh;
-    auto rc = SDL_RenderCopy(rend, tex, nullptr, &r);
-    assert(!rc);
+// Entities spread evenly along the motion path, cycling through the
+// sprites. The default of three is the original blue, red and green.
+void make_scene(entity_store &scene, int count) {
+    scene.clear();
+    for(int i=0; i<count; ++i) {
+        scene.add(float(i)/count, i % int(image_files.size()));
+    }
 }
 
-void render(SDL_Renderer *rend, const resources &res, const double ratio) {
+// Draws the visible part of the scene interpolated between two
+// simulation states, and records what it draws if a recorder is given.
+void render(SDL_Renderer *rend, spritebatch &batch, visibility_stage &vis, const resources &res,
+        const entity_store &scene, const render_list &prev, const render_list &cur, const float alpha,
+        render_recorder *rec = nullptr) {
+    vis.update(scene, res.sprites, prev, cur, alpha);
     assert(!SDL_SetRenderDrawColor(rend, 0, 0, 0, 0));
     SDL_RenderClear(rend);
+    if(rec) {
+        rec->clear(SDL_Color{0, 0, 0, 0});
+    }
     assert(!SDL_SetRenderDrawColor(rend, 255, 255, 255, 0));
-    draw_single(rend, res.blue_tex, ratio);
-    draw_single(rend, res.red_tex, ratio + 0.3333);
-    draw_single(rend, res.green_tex, ratio + 0.6666);
-    SDL_RenderPresent(rend);
+    int layer = vis.visible.empty() ? 0 : scene.layer[vis.visible.front().entity];
+    for(const auto &v : vis.visible) {
+        // The batch groups by texture, so a layer has to be submitted
+        // before the next one starts.
+        if(scene.layer[v.entity] != layer) {
+            batch.flush(rend);
+            if(rec) {
+                rec->flush();
+            }
+            layer = scene.layer[v.entity];
+        }
+        const auto &spr = res.sprites[scene.sprite_id[v.entity]];
+        const SDL_FRect dst{v.x, v.y, float(texw), float(texh)};
+        batch.add(spr.tex, &spr.src, dst);
+        if(rec) {
+            rec->draw(scene.sprite_id[v.entity], dst);
+        }
+    }
+    batch.flush(rend);
+}
+
+// Shows the frame rate and entity count in the title once a second.
+// SDL allocates for the title, and for the window events that follow,
+// so only the printout is done while allocations are being measured.
+void report_rate(SDL_Window *win, const frameprofiler &prof, int entities, bool set_title) {
+    static Uint32 last_report = 0;
+    const auto now = SDL_GetTicks();
+    if(now - last_report < 1000 || prof.num_frames() == 0) {
+        return;
+    }
+    last_report = now;
+    double total = 0;
+    int frames = 0;
+    for(size_t i=prof.num_frames(); i>0 && total < 1000; --i, ++frames) {
+        total += prof.to_ms(prof.frame(i - 1).total_ticks);
+    }
+    if(set_title) {
+        char title[128];
+        snprintf(title, sizeof(title), "SDL test app - %d entities - %.1f fps", entities, 1000*frames/total);
+        SDL_SetWindowTitle(win, title);
+    }
+    printf("%d entities: %.1f fps\n", entities, 1000*frames/total);
+}
+
+// Decides whether a frame needs to be drawn at all in power save
+// mode. Nothing is drawn while the window can not be seen, and a frame
+// identical to the last presented one is not drawn again.
+struct redraw_tracker {
+    bool visible = true;
+    bool damaged = true;
+    int64_t last_step = -1;
+    float last_alpha = -1;
+
+    void window_event(const SDL_WindowEvent &w) {
+        switch(w.event) {
+        case SDL_WINDOWEVENT_HIDDEN:
+        case SDL_WINDOWEVENT_MINIMIZED:
+            visible = false;
+            break;
+        case SDL_WINDOWEVENT_SHOWN:
+        case SDL_WINDOWEVENT_RESTORED:
+        case SDL_WINDOWEVENT_MAXIMIZED:
+        case SDL_WINDOWEVENT_EXPOSED:
+        case SDL_WINDOWEVENT_SIZE_CHANGED:
+            visible = true;
+            damaged = true;
+            break;
+        }
+    }
+
+    bool needs_redraw(int64_t step, float alpha, bool overlay) {
+        if(!visible) {
+            return false;
+        }
+        // The overlay shows live timings, so it always changes.
+        if(!damaged && !overlay && step == last_step && alpha == last_alpha) {
+            return false;
+        }
+        damaged = false;
+        last_step = step;
+        last_alpha = alpha;
+        return true;
+    }
+};
+
+// Ties audio emitters to entities so their sounds pan and fade as
+// they move. The listener is in the middle of the screen. Emitters are
+// reused round robin, with more of them than voices a reused one has
+// almost always finished playing.
+struct emitter_tracker {
+    int entity[max_emitters];
+    int next = 0;
+
+    emitter_tracker() {
+        std::fill(entity, entity + max_emitters, -1);
+    }
+
+    int attach(int entity_index) {
+        const int e = next;
+        next = (next + 1) % max_emitters;
+        entity[e] = entity_index;
+        return e;
+    }
+
+    void update(audiocontrol &control, const render_list &prev, const render_list &cur, float alpha) const {
+        for(int e=0; e<max_emitters; ++e) {
+            const int i = entity[e];
+            if(i < 0 || size_t(i) >= cur.size()) {
+                continue;
+            }
+            const float x = prev.x[i] + alpha*(cur.x[i] - prev.x[i]) + texw/2;
+            const float y = prev.y[i] + alpha*(cur.y[i] - prev.y[i]) + texh/2;
+            control.set_emitter(e, spatialize(x, y, SCREEN_WIDTH/2, SCREEN_HEIGHT/2,
+                    SCREEN_WIDTH/2, SCREEN_HEIGHT/4));
+        }
+    }
+};
+
+// The entity whose sprite is closest to a point, -1 if there are none.
+int nearest_entity(const render_list &l, float x, float y) {
+    int best = -1;
+    float best_d2 = 0;
+    for(size_t i=0; i<l.size(); ++i) {
+        const float dx = l.x[i] + texw/2 - x;
+        const float dy = l.y[i] + texh/2 - y;
+        const float d2 = dx*dx + dy*dy;
+        if(best < 0 || d2 < best_d2) {
+            best = int(i);
+            best_d2 = d2;
+        }
+    }
+    return best;
 }
 
-void mainloop(SDL_Window *win, SDL_Renderer *rend, audiocontrol &control) {
+const int loading_poll_ms = 10;
+
+// How long the previous frame allows the loop to block waiting for
+// events, -1 meaning until the next event. When the window is hidden
+// or the animation is paused only an event can change anything. The
+// wait also ends when a sound may have finished, so the loop can react.
+int idle_timeout_ms(const redraw_tracker &redraw, bool paused, const sim_pipeline &sim, const resources &res,
+        const audiocontrol &control) {
+    if(!res.ready()) {
+        // Finished loads are only picked up by the loop.
+        return loading_poll_ms;
+    }
+    int timeout = -1;
+    if(redraw.visible && !paused) {
+        timeout = int(sim.seconds_to_next_step()*1000);
+    }
+    const int voice_ms = control.ms_to_voice_end();
+    if(voice_ms >= 0 && (timeout < 0 || voice_ms < timeout)) {
+        timeout = voice_ms;
+    }
+    return timeout;
+}
+
+// Fails if --profile-csv measured heap allocations in steady frames.
+int mainloop(SDL_Window *win, SDL_Renderer *rend, audiocontrol &control, const app_options &opts) {
     SDL_Event e;
-    resources res(rend);
-    auto start_time = SDL_GetTicks();
-    const int cycle = 2000;
-    auto last_frame = SDL_GetTicks();
+    workerpool pool;
+    const auto load_start = SDL_GetPerformanceCounter();
+    asset_source source(pool, opts.pack_file, opts.stream_min, opts.pcm_cache);
+    auto resptr = source.upload(rend, &control);
+    resources &res = *resptr;
+    audio_stopper stop_audio{control};
+    std::unique_ptr<file_watcher> watcher;
+    if(opts.watch) {
+        if(source.from_pack) {
+            printf("Assets from a pack can not be reloaded, not watching res/.\n");
+        } else {
+            // Only wakes up power save waits, changes are taken every frame.
+            const Uint32 watch_event = SDL_RegisterEvents(1);
+            watcher = std::make_unique<file_watcher>("res", watch_event == Uint32(-1) ? 0 : watch_event);
+        }
+    }
+    spritebatch batch;
+    visibility_stage vis(SCREEN_WIDTH, SCREEN_HEIGHT, texw, texh);
+    entity_store scene;
+    make_scene(scene, opts.entities);
+    sim_pipeline sim(pool, scene, scene_motion_for(opts), 1.0/opts.sim_rate, cycle_seconds);
+    auto last_time = SDL_GetPerformanceCounter();
     SDL_RendererInfo f;
     SDL_GetRendererInfo(rend, &f);
     int has_vsync = f.flags & SDL_RENDERER_PRESENTVSYNC;
-    control.play_sample(res.startup_sound);
+    framepacer pacer(opts.target_fps > 0 ? opts.target_fps : display_refresh_rate(win));
+    frameprofiler prof;
+    prof.overlay_visible = opts.profile_overlay;
+    redraw_tracker redraw;
     SDL_PauseAudioDevice(control.dev, 0);
-    while(true) {
+    bool running = true;
+    bool paused = false;
+    bool idle = false;
+    bool loaded = false;
+    input_tracer tracer(opts.trace_file != nullptr);
+    audio_trace consumed;
+    std::unique_ptr<render_recorder> recorder;
+    if(opts.record_file) {
+        recorder = std::make_unique<render_recorder>(opts.record_file, SCREEN_WIDTH, SCREEN_HEIGHT);
+        if(!recorder->ok()) {
+            recorder.reset();
+        }
+    }
+    auto last_present = SDL_GetPerformanceCounter();
+    emitter_tracker emitters;
+    // Keyboard and joystick sounds come from entities picked in turn.
+    size_t next_source = 0;
+    auto play_at = [&](sound_id id, int priority, int entity, Uint32 trace_id) {
+        play_params p;
+        p.priority = priority;
+        p.trace_id = trace_id;
+        if(entity >= 0) {
+            p.emitter = emitters.attach(entity);
+            emitters.update(control, sim.previous(), sim.current(), sim.alpha());
+        }
+        control.play(res.sound(id), p);
+    };
+    auto pick_source = [&]() {
+        if(scene.size() == 0) {
+            return -1;
+        }
+        next_source = (next_source + 7919) % scene.size();
+        return int(next_source);
+    };
+    auto handle_event = [&](const SDL_Event &e) {
+        Uint32 trace_id = 0;
+        if(e.type == SDL_KEYDOWN || e.type == SDL_JOYBUTTONDOWN || e.type == SDL_MOUSEBUTTONDOWN) {
+            trace_id = tracer.input(e);
+        }
+        if(e.type == SDL_QUIT) {
+            running = false;
+        } else if(e.type == SDL_KEYDOWN) {
+            switch(e.key.keysym.sym) {
+            case  SDLK_ESCAPE:
+            case  SDLK_q:
+                running = false;
+                break;
+            case SDLK_F3:
+                prof.overlay_visible = !prof.overlay_visible;
+                break;
+            case SDLK_p:
+                paused = !paused;
+                break;
+            default:
+                play_at(SOUND_EXPLODE, PRIORITY_NORMAL, pick_source(), trace_id);
+            }
+        } else if(e.type == SDL_MOUSEBUTTONDOWN) {
+            const int target = nearest_entity(sim.current(), float(e.button.x), float(e.button.y));
+            play_at(SOUND_SHOOT, PRIORITY_LOW, target, trace_id);
+        } else if(e.type == SDL_JOYBUTTONDOWN) {
+            play_at(SOUND_SHOOT, PRIORITY_LOW, pick_source(), trace_id);
+        } else if(e.type == SDL_WINDOWEVENT) {
+            redraw.window_event(e.window);
+            if(e.window.event == SDL_WINDOWEVENT_DISPLAY_CHANGED && opts.target_fps <= 0) {
+                pacer.set_target(display_refresh_rate(win));
+            }
+        }
+    };
+    while(running) {
+        prof.begin_frame();
+        if(idle) {
+            const int timeout = idle_timeout_ms(redraw, paused, sim, res, control);
+            const int got = timeout < 0 ? SDL_WaitEvent(&e) : SDL_WaitEventTimeout(&e, timeout);
+            if(got) {
+                handle_event(e);
+            }
+        }
         while(SDL_PollEvent(&e)) {
-            if(e.type == SDL_QUIT) {
-                return;
+            handle_event(e);
+        }
+        prof.end_phase(PHASE_EVENTS);
+        const auto now = SDL_GetPerformanceCounter();
+        if(!paused) {
+            sim.advance(double(now - last_time)/SDL_GetPerformanceFrequency());
+        }
+        last_time = now;
+        while(control.traced.pop(consumed)) {
+            tracer.add_audio(consumed);
+        }
+        if(watcher) {
+            for(const auto &name : watcher->take_changes()) {
+                res.reload(("res/" + name).c_str());
+            }
+        }
+        if(res.update()) {
+            // Placeholders were replaced.
+            redraw.damaged = true;
+        }
+        if(!loaded && res.ready()) {
+            printf("Assets loaded in %.1f ms.\n",
+                    1000.0*(SDL_GetPerformanceCounter() - load_start)/SDL_GetPerformanceFrequency());
+            play_at(SOUND_STARTUP, PRIORITY_HIGH, -1, 0);
+            loaded = true;
+        }
+        emitters.update(control, sim.previous(), sim.current(), sim.alpha());
+        prof.end_phase(PHASE_UPDATE);
+        idle = opts.power_save && !redraw.needs_redraw(sim.steps(), sim.alpha(), prof.overlay_visible);
+        if(idle) {
+            // Skipped frames are not interesting to the profiler.
+            continue;
+        }
+        render(rend, batch, vis, res, scene, sim.previous(), sim.current(), sim.alpha(), recorder.get());
+        if(prof.overlay_visible) {
+            prof.draw_overlay(rend);
+        }
+        prof.end_phase(PHASE_RENDER);
+        SDL_RenderPresent(rend);
+        tracer.presented();
+        if(recorder) {
+            const auto presented = SDL_GetPerformanceCounter();
+            recorder->present(double(presented - last_present)/SDL_GetPerformanceFrequency(),
+                    sim.alpha(), sim.steps());
+            last_present = presented;
+        }
+        prof.end_phase(PHASE_PRESENT);
+        if(!has_vsync) {
+            pacer.wait();
+        }
+        prof.end_phase(PHASE_SLEEP);
+        prof.end_frame();
+        if(opts.entities != default_entities) {
+            report_rate(win, prof, int(scene.size()), !opts.profile_csv);
+        }
+    }
+    int ret = 0;
+    if(opts.profile_csv) {
+        const auto st = prof.stats();
+        printf("Frame times over %d frames: p50 %.2f ms, p99 %.2f ms, max %.2f ms.\n",
+                int(st.frames), st.p50_ms, st.p99_ms, st.max_ms);
+        printf("At most %d heap allocations per frame after warm-up.\n", int(st.steady_allocs));
+        prof.write_csv(opts.profile_csv);
+        if(st.steady_allocs != 0) {
+            printf("Steady frames should not allocate.\n");
+            ret = 1;
+        }
+    }
+    if(recorder) {
+        printf("Recorded %d frames to %s.\n", int(recorder->frames()), opts.record_file);
+    }
+    if(tracer.enabled()) {
+        while(control.traced.pop(consumed)) {
+            tracer.add_audio(consumed);
+        }
+        tracer.print_summary();
+        tracer.write_json(opts.trace_file);
+    }
+    return ret;
+}
+
+// Hands simulated frames from the main thread to the window render
+// threads. The simulation is only advanced once every thread has read
+// the previous frame, so all windows draw the same state.
+struct frame_handoff {
+    std::mutex m;
+    std::condition_variable cv;
+    const render_list *prev = nullptr;
+    const render_list *cur = nullptr;
+    float alpha = 0;
+    int64_t frame = 0;
+    int starting;
+    int readers = 0;
+    int unread = 0;
+    bool stopping = false;
+
+    explicit frame_handoff(int threads) : starting(threads) {}
+
+    // Render thread, once its renderer is set up or has failed.
+    void started(bool ok) {
+        std::lock_guard<std::mutex> lock(m);
+        --starting;
+        if(ok) {
+            ++readers;
+        }
+        cv.notify_all();
+    }
+
+    // Returns how many render threads are running.
+    int wait_started() {
+        std::unique_lock<std::mutex> lock(m);
+        cv.wait(lock, [this] { return starting == 0; });
+        return readers;
+    }
+
+    void publish(const render_list &p, const render_list &c, float a) {
+        std::lock_guard<std::mutex> lock(m);
+        prev = &p;
+        cur = &c;
+        alpha = a;
+        ++frame;
+        unread = readers;
+        cv.notify_all();
+    }
+
+    void wait_read() {
+        std::unique_lock<std::mutex> lock(m);
+        cv.wait(lock, [this] { return unread == 0; });
+    }
+
+    // Render thread. Returns false once stopped.
+    bool wait_frame(int64_t &seen) {
+        std::unique_lock<std::mutex> lock(m);
+        cv.wait(lock, [&] { return stopping || frame != seen; });
+        seen = frame;
+        return !stopping;
+    }
+
+    void done_reading() {
+        std::lock_guard<std::mutex> lock(m);
+        if(--unread == 0) {
+            cv.notify_all();
+        }
+    }
+
+    void stop() {
+        std::lock_guard<std::mutex> lock(m);
+        stopping = true;
+        cv.notify_all();
+    }
+};
+
+// The renderer is created on the thread that uses it, so that its
+// context belongs to that thread. Presenting, and waiting for vsync,
+// overlaps with the main thread simulating the next frame.
+void window_thread(SDL_Window *win, const shared_assets &shared, const entity_store &scene, frame_handoff &handoff) {
+    SDL_Renderer *rend = SDL_CreateRenderer(win, -1, SDL_RENDERER_ACCELERATED|SDL_RENDERER_PRESENTVSYNC);
+    if(!rend) {
+        rend = SDL_CreateRenderer(win, -1, 0);
+    }
+    if(!rend) {
+        printf("Renderer setup failed: %s\n", SDL_GetError());
+        handoff.started(false);
+        return;
+    }
+    {
+        auto res = shared.upload(rend);
+        spritebatch batch;
+        visibility_stage vis(SCREEN_WIDTH, SCREEN_HEIGHT, texw, texh);
+        handoff.started(true);
+        int64_t seen = 0;
+        while(handoff.wait_frame(seen)) {
+            render(rend, batch, vis, *res, scene, *handoff.prev, *handoff.cur, handoff.alpha);
+            handoff.done_reading();
+            SDL_RenderPresent(rend);
+        }
+    }
+    SDL_DestroyRenderer(rend);
+}
+
+// Shows the scene in opts.windows windows, one per display for as
+// long as there are displays. Assets are decoded once up front and
+// uploaded to every window's renderer. Events, simulation and audio
+// stay on the main thread.
+int run_windows(const app_options &opts, audiocontrol &control) {
+    workerpool pool;
+    const auto load_start = SDL_GetPerformanceCounter();
+    asset_source source(pool, opts.pack_file, opts.stream_min, opts.pcm_cache);
+    shared_assets shared(source);
+    audio_stopper stop_audio{control};
+    entity_store scene;
+    make_scene(scene, opts.entities);
+    sim_pipeline sim(pool, scene, scene_motion_for(opts), 1.0/opts.sim_rate, cycle_seconds);
+    const int displays = std::max(1, SDL_GetNumVideoDisplays());
+    std::vector<SDL_Window*> windows;
+    for(int i=0; i<opts.windows; ++i) {
+        const int pos = i < displays ? int(SDL_WINDOWPOS_CENTERED_DISPLAY(i)) : int(SDL_WINDOWPOS_UNDEFINED);
+        SDL_Window *win = SDL_CreateWindow("SDL test app", pos, pos, SCREEN_WIDTH, SCREEN_HEIGHT, window_flags);
+        if(!win) {
+            printf("Window creation failed: %s\n", SDL_GetError());
+            break;
+        }
+        windows.push_back(win);
+    }
+    frame_handoff handoff(int(windows.size()));
+    std::vector<std::thread> threads;
+    for(auto *win : windows) {
+        threads.emplace_back(window_thread, win, std::cref(shared), std::cref(scene), std::ref(handoff));
+    }
+    const int running_windows = handoff.wait_started();
+    SDL_PauseAudioDevice(control.dev, 0);
+    if(running_windows > 0) {
+        printf("Assets loaded for %d windows in %.1f ms.\n", running_windows,
+                1000.0*(SDL_GetPerformanceCounter() - load_start)/SDL_GetPerformanceFrequency());
+        play_params startup;
+        startup.priority = PRIORITY_HIGH;
+        control.play(shared.sounds[SOUND_STARTUP], startup);
+    }
+    SDL_Event e;
+    bool running = running_windows > 0;
+    auto last_time = SDL_GetPerformanceCounter();
+    while(running) {
+        while(SDL_PollEvent(&e)) {
+            if(e.type == SDL_QUIT || (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_CLOSE)) {
+                running = false;
             } else if(e.type == SDL_KEYDOWN) {
-                switch(e.key.keysym.sym) {
-                case  SDLK_ESCAPE:
-                case  SDLK_q:
-                    return;
+                if(e.key.keysym.sym == SDLK_ESCAPE || e.key.keysym.sym == SDLK_q) {
+                    running = false;
+                } else {
+                    control.play(shared.sounds[SOUND_EXPLODE]);
                 }
-                control.play_sample(res.explode_sound);
             } else if(e.type == SDL_JOYBUTTONDOWN || e.type == SDL_MOUSEBUTTONDOWN) {
-                control.play_sample(res.shoot_sound);
+                play_params shot;
+                shot.priority = PRIORITY_LOW;
+                control.play(shared.sounds[SOUND_SHOOT], shot);
             }
         }
-        render(rend, res, ((SDL_GetTicks() - start_time) % cycle)/double(cycle));
-        if(!has_vsync) {
-            auto time_spent = SDL_GetTicks() - last_frame;
-            if(time_spent < FTIME) {
-                SDL_Delay(FTIME - time_spent);
+        // Blocks for as long as the slowest window takes to present.
+        handoff.wait_read();
+        const auto now = SDL_GetPerformanceCounter();
+        sim.advance(double(now - last_time)/SDL_GetPerformanceFrequency());
+        last_time = now;
+        handoff.publish(sim.previous(), sim.current(), sim.alpha());
+    }
+    handoff.stop();
+    for(auto &t : threads) {
+        t.join();
+    }
+    for(auto *win : windows) {
+        SDL_DestroyWindow(win);
+    }
+    return running_windows > 0 ? 0 : 1;
+}
+
+void report_bench(const char *driver, int entities, const frameprofiler &prof, double seconds) {
+    std::vector<double> ms;
+    for(size_t i=0; i<prof.num_frames(); ++i) {
+        ms.push_back(prof.to_ms(prof.frame(i).total_ticks));
+    }
+    std::sort(ms.begin(), ms.end());
+    auto pct = [&ms](double p) { return ms[std::min(ms.size() - 1, size_t(p*(ms.size() - 1) + 0.5))]; };
+    printf("%-12s %8d entities %8.1f fps  min %.3f  p50 %.3f  p90 %.3f  p99 %.3f  max %.3f ms  %d allocs/frame\n",
+            driver, entities, ms.size()/seconds, ms.front(), pct(0.5), pct(0.9), pct(0.99), ms.back(),
+            int(prof.stats().steady_allocs));
+}
+
+// Bench windows have the same flags as run_window's. By default they
+// are hidden, which needs no desktop and gives the same numbers every
+// run, but some drivers and compositors throttle or skip presents to
+// hidden windows. Shown ones present like the real window does. They
+// are borderless and just past the right edge of the first display,
+// but a window manager may still move them on screen and compositors
+// may throttle windows that are entirely offscreen, so their timings
+// depend on the desktop.
+SDL_Window* create_bench_window(int w, int h, bool visible) {
+    if(!visible) {
+        return SDL_CreateWindow("SDL test bench", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, w, h,
+                window_flags | SDL_WINDOW_HIDDEN);
+    }
+    int x = SDL_WINDOWPOS_UNDEFINED;
+    int y = SDL_WINDOWPOS_UNDEFINED;
+    SDL_Rect bounds;
+    if(SDL_GetDisplayBounds(0, &bounds) == 0) {
+        x = bounds.x + bounds.w;
+        y = bounds.y;
+    }
+    return SDL_CreateWindow("SDL test bench", x, y, w, h, window_flags | SDL_WINDOW_BORDERLESS);
+}
+
+// Calls f(driver name, renderer, resources) with a bench window for
+// each requested render driver. Every driver gets the same decoded
+// assets, so decoding is done once and not part of any comparison.
+template<typename F>
+int for_each_bench_driver(const app_options &opts, const shared_assets &shared, int w, int h, F &&f) {
+    const bool all = opts.driver && strcmp(opts.driver, "all") == 0;
+    int benched = 0;
+    for(int i=0; i<SDL_GetNumRenderDrivers(); ++i) {
+        SDL_RendererInfo info;
+        SDL_GetRenderDriverInfo(i, &info);
+        if(!all && opts.driver && strcmp(opts.driver, info.name) != 0) {
+            continue;
+        }
+        SDL_Window *win = create_bench_window(w, h, opts.bench_visible);
+        if(!win) {
+            printf("Window creation failed: %s\n", SDL_GetError());
+            return 1;
+        }
+        // No SDL_RENDERER_PRESENTVSYNC, and no frame pacing in f.
+        SDL_Renderer *rend = SDL_CreateRenderer(win, i, 0);
+        if(!rend) {
+            printf("%-12s could not be created: %s\n", info.name, SDL_GetError());
+            SDL_DestroyWindow(win);
+            continue;
+        }
+        {
+            auto res = shared.upload(rend);
+            f(info.name, rend, *res);
+        }
+        SDL_DestroyRenderer(rend);
+        SDL_DestroyWindow(win);
+        ++benched;
+        if(!all && !opts.driver) {
+            break;
+        }
+    }
+    if(benched == 0) {
+        printf("No usable render driver found.\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Renders and presents bench_frames frames as fast as possible on a
+// bench window for each requested render driver.
+int run_bench(const app_options &opts) {
+    workerpool pool;
+    asset_source source(pool, opts.pack_file, opts.stream_min, opts.pcm_cache);
+    shared_assets shared(source);
+    bool allocated = false;
+    const int ret = for_each_bench_driver(opts, shared, SCREEN_WIDTH, SCREEN_HEIGHT,
+            [&](const char *driver, SDL_Renderer *rend, resources &res) {
+        std::vector<int> counts;
+        if(opts.entity_sweep) {
+            for(int c=10; c<=max_entities; c*=10) {
+                counts.push_back(c);
+            }
+        } else {
+            counts.push_back(opts.entities);
+        }
+        for(const auto count : counts) {
+            entity_store scene;
+            make_scene(scene, count);
+            sim_pipeline sim(pool, scene, scene_motion_for(opts), 1.0/opts.sim_rate, cycle_seconds);
+            spritebatch batch;
+            visibility_stage vis(SCREEN_WIDTH, SCREEN_HEIGHT, texw, texh);
+            frameprofiler prof;
+            SDL_Event e;
+            const auto start = SDL_GetPerformanceCounter();
+            for(int frame=0; frame<opts.bench_frames; ++frame) {
+                prof.begin_frame();
+                while(SDL_PollEvent(&e)) {
+                }
+                prof.end_phase(PHASE_EVENTS);
+                // Fixed steps so that every run draws the same frames.
+                sim.advance(cycle_seconds/120);
+                prof.end_phase(PHASE_UPDATE);
+                render(rend, batch, vis, res, scene, sim.previous(), sim.current(), sim.alpha());
+                prof.end_phase(PHASE_RENDER);
+                SDL_RenderPresent(rend);
+                prof.end_phase(PHASE_PRESENT);
+                prof.end_frame();
             }
+            const double seconds = prof.to_ms(SDL_GetPerformanceCounter() - start)/1000;
+            report_bench(driver, count, prof, seconds);
+            allocated = allocated || prof.stats().steady_allocs != 0;
         }
-        last_frame = SDL_GetTicks(); // Not accurate, but good enough.
+    });
+    if(ret == 0 && allocated) {
+        printf("Steady frames should not allocate.\n");
+        return 1;
+    }
+    return ret;
+}
+
+// Submits a recorded session's frames as fast as possible, without
+// simulation, input or pacing, for each requested render driver.
+int run_replay(const app_options &opts) {
+    render_replay replay;
+    if(!replay.load(opts.replay_file)) {
+        return 1;
     }
+    workerpool pool;
+    asset_source source(pool, opts.pack_file, opts.stream_min, opts.pcm_cache);
+    shared_assets shared(source);
+    const int w = replay.width() > 0 ? replay.width() : SCREEN_WIDTH;
+    const int h = replay.height() > 0 ? replay.height() : SCREEN_HEIGHT;
+    return for_each_bench_driver(opts, shared, w, h,
+            [&](const char *driver, SDL_Renderer *rend, resources &res) {
+        spritebatch batch;
+        frameprofiler prof;
+        SDL_Event e;
+        replay.rewind();
+        const auto start = SDL_GetPerformanceCounter();
+        while(true) {
+            prof.begin_frame();
+            while(SDL_PollEvent(&e)) {
+            }
+            prof.end_phase(PHASE_EVENTS);
+            prof.end_phase(PHASE_UPDATE);
+            if(!replay.next_frame(rend, batch, res.sprites)) {
+                break;
+            }
+            prof.end_phase(PHASE_RENDER);
+            SDL_RenderPresent(rend);
+            prof.end_phase(PHASE_PRESENT);
+            prof.end_frame();
+        }
+        if(replay.corrupt()) {
+            printf("Recording is corrupt after %d frames.\n", int(replay.frames()));
+        }
+        if(prof.num_frames() == 0) {
+            return;
+        }
+        const double seconds = prof.to_ms(SDL_GetPerformanceCounter() - start)/1000;
+        printf("Recorded session: %d frames at %.1f fps.\n", int(replay.frames()),
+                replay.frames()/replay.recorded_seconds());
+        report_bench(driver, int(replay.draws()/replay.frames()), prof, seconds);
+    });
 }
 
+const int probe_entities = 1000;
+const int probe_frames = 60;
+
+// Times a short burst of frames on every render driver and returns
+// the fastest one, or an empty string if none works. The result is
+// cached, so only the first launch or a reprobe pays for it.
+std::string choose_render_driver(const app_options &opts, bool reprobe) {
+    driver_config config;
+    std::string best;
+    if(!reprobe && config.load(best)) {
+        printf("Using render driver %s chosen by an earlier probe.\n", best.c_str());
+        return best;
+    }
+    app_options probe = opts;
+    probe.driver = "all";
+    // The choice is for the real window, on this desktop.
+    probe.bench_visible = true;
+    workerpool pool;
+    asset_source source(pool, opts.pack_file, opts.stream_min, opts.pcm_cache);
+    shared_assets shared(source);
+    double best_ms = 0;
+    for_each_bench_driver(probe, shared, SCREEN_WIDTH, SCREEN_HEIGHT,
+            [&](const char *driver, SDL_Renderer *rend, resources &res) {
+        entity_store scene;
+        make_scene(scene, probe_entities);
+        sim_pipeline sim(pool, scene, scene_motion_for(opts), 1.0/opts.sim_rate, cycle_seconds);
+        spritebatch batch;
+        visibility_stage vis(SCREEN_WIDTH, SCREEN_HEIGHT, texw, texh);
+        SDL_Event e;
+        std::vector<double> ms;
+        for(int frame=0; frame<probe_frames; ++frame) {
+            while(SDL_PollEvent(&e)) {
+            }
+            sim.advance(cycle_seconds/120);
+            const auto start = SDL_GetPerformanceCounter();
+            render(rend, batch, vis, res, scene, sim.previous(), sim.current(), sim.alpha());
+            SDL_RenderPresent(rend);
+            ms.push_back(1000.0*(SDL_GetPerformanceCounter() - start)/SDL_GetPerformanceFrequency());
+        }
+        // The median is not thrown off by the first frames' setup.
+        std::sort(ms.begin(), ms.end());
+        const double median = ms[ms.size()/2];
+        printf("%-12s %.3f ms per frame\n", driver, median);
+        if(best.empty() || median < best_ms) {
+            best = driver;
+            best_ms = median;
+        }
+    });
+    if(best.empty()) {
+        return best;
+    }
+    printf("Fastest render driver is %s.\n", best.c_str());
+    if(config.save(best)) {
+        printf("Saved the choice to %s.\n", config.file().c_str());
+    }
+    return best;
+}
+
+int run_window(const app_options &opts, audiocontrol &control) {
+    SDL_Window *win = SDL_CreateWindow("SDL test app", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+            SCREEN_WIDTH, SCREEN_HEIGHT, window_flags);
+    if(!win) {
+        printf("Window creation failed: %s\n", SDL_GetError());
+        return 1;
+    }
+    SDL_Renderer *rend(SDL_CreateRenderer(win, -1, SDL_RENDERER_ACCELERATED|SDL_RENDERER_PRESENTVSYNC));
+    if(!rend) {
+        printf("Falling back to sw rendering: %s\n", SDL_GetError());
+        rend = SDL_CreateRenderer(win, -1, 0);
+        if(!rend) {
+            printf("Renderer setup failed: %s\n", SDL_GetError());
+            SDL_DestroyWindow(win);
+            return 1;
+        }
+    }
+    const int ret = mainloop(win, rend, control, opts);
+    SDL_DestroyRenderer(rend);
+    SDL_DestroyWindow(win);
+    return ret;
+}
+
+bool parse_args(int argc, char *argv[], app_options &opts) {
+    for(int i=1; i<argc; ++i) {
+        if(strcmp(argv[i], "--pack") == 0 && i+1 < argc) {
+            opts.pack_file = argv[++i];
+        } else if(strcmp(argv[i], "--audio") == 0 && i+1 < argc) {
+            ++i;
+            if(strcmp(argv[i], "mixer") == 0) {
+                opts.audio = audio_backend::mixer;
+            } else if(strcmp(argv[i], "device") == 0) {
+                opts.audio = audio_backend::device;
+            } else {
+                printf("Unknown audio backend: %s\n", argv[i]);
+                return false;
+            }
+        } else if(strcmp(argv[i], "--audio-buffer") == 0 && i+1 < argc) {
+            opts.audio_buffer = atoi(argv[++i]);
+            if(opts.audio_buffer < 64 || opts.audio_buffer > 8192) {
+                printf("Audio buffer must be between 64 and 8192 frames.\n");
+                return false;
+            }
+        } else if(strcmp(argv[i], "--fps") == 0 && i+1 < argc) {
+            opts.target_fps = atof(argv[++i]);
+            if(opts.target_fps <= 0) {
+                printf("Frame rate must be positive.\n");
+                return false;
+            }
+        } else if(strcmp(argv[i], "--driver") == 0 && i+1 < argc) {
+            opts.driver = argv[++i];
+        } else if(strcmp(argv[i], "--bench") == 0 && i+1 < argc) {
+            opts.bench_frames = atoi(argv[++i]);
+            if(opts.bench_frames <= 0) {
+                printf("Benchmark frame count must be positive.\n");
+                return false;
+            }
+        } else if(strcmp(argv[i], "--bench-visible") == 0) {
+            opts.bench_visible = true;
+        } else if(strcmp(argv[i], "--entities") == 0 && i+1 < argc) {
+            ++i;
+            if(strcmp(argv[i], "sweep") == 0) {
+                opts.entity_sweep = true;
+            } else {
+                opts.entities = atoi(argv[i]);
+                if(opts.entities < 1 || opts.entities > max_entities) {
+                    printf("Entity count must be between 1 and %d.\n", max_entities);
+                    return false;
+                }
+            }
+        } else if(strcmp(argv[i], "--sim-rate") == 0 && i+1 < argc) {
+            opts.sim_rate = atof(argv[++i]);
+            if(opts.sim_rate < 1 || opts.sim_rate > 1000) {
+                printf("Simulation rate must be between 1 and 1000 Hz.\n");
+                return false;
+            }
+        } else if(strcmp(argv[i], "--stream-min") == 0 && i+1 < argc) {
+            opts.stream_min = atof(argv[++i]);
+            if(opts.stream_min < 0) {
+                printf("Stream length threshold can not be negative.\n");
+                return false;
+            }
+        } else if(strcmp(argv[i], "--record") == 0 && i+1 < argc) {
+            opts.record_file = argv[++i];
+        } else if(strcmp(argv[i], "--replay") == 0 && i+1 < argc) {
+            opts.replay_file = argv[++i];
+        } else if(strcmp(argv[i], "--motion") == 0 && i+1 < argc) {
+            ++i;
+            if(strcmp(argv[i], "libm") == 0) {
+                opts.motion = motion_eval::libm;
+            } else if(strcmp(argv[i], "approx") == 0) {
+                opts.motion = motion_eval::approx;
+            } else if(strcmp(argv[i], "lut") == 0) {
+                opts.motion = motion_eval::lut;
+            } else {
+                printf("Unknown motion evaluation: %s\n", argv[i]);
+                return false;
+            }
+        } else if(strcmp(argv[i], "--windows") == 0 && i+1 < argc) {
+            opts.windows = atoi(argv[++i]);
+            if(opts.windows < 1 || opts.windows > max_windows) {
+                printf("Window count must be between 1 and %d.\n", max_windows);
+                return false;
+            }
+        } else if(strcmp(argv[i], "--trace") == 0 && i+1 < argc) {
+            opts.trace_file = argv[++i];
+        } else if(strcmp(argv[i], "--no-pcm-cache") == 0) {
+            opts.pcm_cache = false;
+        } else if(strcmp(argv[i], "--watch") == 0) {
+            opts.watch = true;
+        } else if(strcmp(argv[i], "--power-save") == 0) {
+            opts.power_save = true;
+        } else if(strcmp(argv[i], "--profile") == 0) {
+            opts.profile_overlay = true;
+        } else if(strcmp(argv[i], "--profile-csv") == 0 && i+1 < argc) {
+            opts.profile_csv = argv[++i];
+        } else {
+            printf("Unknown argument: %s\n", argv[i]);
+            printf("Usage: %s [--pack FILE] [--audio mixer|device] [--audio-buffer FRAMES]\n"
+                   "       [--profile] [--profile-csv FILE] [--fps RATE]\n"
+                   "       [--driver NAME|all|auto|probe] [--bench FRAMES] [--bench-visible]\n"
+                   "       [--entities COUNT|sweep]\n"
+                   "       [--sim-rate HZ] [--power-save] [--stream-min SECONDS] [--watch]\n"
+                   "       [--trace FILE] [--record FILE] [--replay FILE] [--windows COUNT]\n"
+                   "       [--motion libm|approx|lut] [--no-pcm-cache]\n", argv[0]);
+            return false;
+        }
+    }
+    if(opts.driver && strcmp(opts.driver, "all") == 0 && opts.bench_frames == 0 && !opts.replay_file) {
+        printf("--driver all can only be used with --bench or --replay.\n");
+        return false;
+    }
+    if(opts.driver && (strcmp(opts.driver, "auto") == 0 || strcmp(opts.driver, "probe") == 0) &&
+            (opts.bench_frames > 0 || opts.replay_file)) {
+        printf("--driver %s can not be used with --bench or --replay.\n", opts.driver);
+        return false;
+    }
+    if(opts.entity_sweep && opts.bench_frames == 0) {
+        printf("--entities sweep can only be used with --bench.\n");
+        return false;
+    }
+    if(opts.windows > 1 && (opts.watch || opts.power_save || opts.trace_file || opts.record_file ||
+            opts.profile_overlay || opts.profile_csv)) {
+        printf("Watching, power save, tracing, recording and profiling need a single window.\n");
+        return false;
+    }
+    return true;
+}
 
 int main(int argc, char *argv[]) {
+    app_options opts;
+    if(!parse_args(argc, argv, opts)) {
+        return 1;
+    }
+    count_sdl_allocations();
     if(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS | SDL_INIT_GAMECONTROLLER |
             SDL_INIT_JOYSTICK | SDL_INIT_AUDIO) != 0) {
         fprintf(stderr, "Could not initialize SDL: %s\n", SDL_GetError());
@@ -195,35 +1233,58 @@ int main(int argc, char *argv[]) {
         printf("Mix_Init: %s\n", Mix_GetError());
         return 1;
     }
-    if(Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 1024)==-1) {
+    // With the device backend SDL_mixer is still needed for decoding
+    // and format conversion, but its own output stays silent.
+    int mixer_buffer = default_mixer_buffer;
+    if(opts.audio == audio_backend::mixer && opts.audio_buffer > 0) {
+        mixer_buffer = opts.audio_buffer;
+    }
+    if(Mix_OpenAudio(mix_frequency, mix_format, mix_channels, mixer_buffer)==-1) {
         printf("Mix_OpenAudio: %s\n", Mix_GetError());
         return 1;
     }
     SDL_LogSetPriority(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_DEBUG);
     atexit(SDL_Quit);
+    if(opts.replay_file) {
+        return run_replay(opts);
+    }
+    if(opts.bench_frames > 0) {
+        return run_bench(opts);
+    }
+    const char *driver = opts.driver;
+    std::string probed;
+    if(driver && (strcmp(driver, "auto") == 0 || strcmp(driver, "probe") == 0)) {
+        probed = choose_render_driver(opts, strcmp(driver, "probe") == 0);
+        driver = probed.empty() ? nullptr : probed.c_str();
+    }
+    if(driver) {
+        SDL_SetHintWithPriority(SDL_HINT_RENDER_DRIVER, driver, SDL_HINT_OVERRIDE);
+    }
 #if defined(_MSC_VER)
-    SDL_SetHintWithPriority(SDL_HINT_RENDER_DRIVER, "direct3d11", SDL_HINT_OVERRIDE);
-    SDL_Window *win = SDL_CreateWindow("SDL test app", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, SCREEN_WIDTH, SCREEN_HEIGHT, 0);
-#else
-    SDL_Window *win = SDL_CreateWindow("SDL test app", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_OPENGL);
+    if(!driver) {
+        SDL_SetHintWithPriority(SDL_HINT_RENDER_DRIVER, "direct3d11", SDL_HINT_OVERRIDE);
+    }
 #endif
-    if(!win) {
-        printf("Window creation failed: %s\n", SDL_GetError());
+    int mixer_freq;
+    Uint16 mixer_format;
+    int mixer_channels;
+    Mix_QuerySpec(&mixer_freq, &mixer_format, &mixer_channels);
+    if(mixer_format != AUDIO_S16SYS) {
+        printf("Mixer did not provide 16 bit output.\n");
         return 1;
     }
-    SDL_Renderer *rend(SDL_CreateRenderer(win, -1, SDL_RENDERER_ACCELERATED|SDL_RENDERER_PRESENTVSYNC));
-    if(!rend) {
-        printf("Falling back to sw rendering: %s\n", SDL_GetError());
-        rend = SDL_CreateRenderer(win, -1, 0);
-        if(!rend) {
-            printf("Renderer setup failed: %s\n", SDL_GetError());
+    audiocontrol control;
+    control.open_streams(mixer_freq, mixer_channels);
+    if(opts.audio == audio_backend::device) {
+        const int frames = opts.audio_buffer > 0 ? opts.audio_buffer : default_device_buffer;
+        if(!control.open_device(mixer_freq, mixer_channels, frames)) {
             return 1;
         }
+    } else {
+        // All sound effects are mixed by audiocontrol, SDL_mixer only
+        // provides the output stream.
+        control.hook_mixer();
     }
-    audiocontrol control;
 
-    mainloop(win, rend, control);
-    SDL_DestroyRenderer(rend);
-    SDL_DestroyWindow(win);
-    return 0;
+    return opts.windows > 1 ? run_windows(opts, control) : run_window(opts, control);
 }
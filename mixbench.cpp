@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+// Measures how many samples per second each mixing kernel can mix.
+
+#include<SDL.h>
+#include"mixkernels.hpp"
+#include<cstdio>
+#include<cstdlib>
+#include<vector>
+
+namespace {
+
+const int num_voices = 16;
+// 1024 stereo frames, the same as one default mixer callback.
+const int buffer_samples = 2048;
+const double bench_seconds = 0.5;
+
+std::vector<Sint16> random_samples(size_t n) {
+    std::vector<Sint16> v(n);
+    for(auto &s : v) {
+        s = Sint16(rand() - RAND_MAX/2);
+    }
+    return v;
+}
+
+void mix_all(const mix_kernel &k, Sint16 *out, const std::vector<std::vector<Sint16>> &voices) {
+    SDL_memset(out, 0, buffer_samples*sizeof(Sint16));
+    for(size_t i=0; i<voices.size(); ++i) {
+        k.add(out, voices[i].data(), buffer_samples, int(64 + i*4), int(128 - i*4));
+    }
+    k.scale(out, buffer_samples, 100);
+}
+
+}
+
+int main(int, char **) {
+    std::vector<std::vector<Sint16>> voices;
+    for(int i=0; i<num_voices; ++i) {
+        voices.push_back(random_samples(buffer_samples));
+    }
+    const auto kernels = available_mix_kernels();
+    std::vector<Sint16> reference(buffer_samples);
+    mix_all(kernels.front(), reference.data(), voices);
+    const double freq = double(SDL_GetPerformanceFrequency());
+    int failures = 0;
+    for(const auto &k : kernels) {
+        std::vector<Sint16> out(buffer_samples);
+        mix_all(k, out.data(), voices);
+        if(out != reference) {
+            printf("%-8s output differs from the scalar kernel.\n", k.name);
+            ++failures;
+            continue;
+        }
+        long long rounds = 0;
+        const auto start = SDL_GetPerformanceCounter();
+        Uint64 now;
+        do {
+            for(int r=0; r<100; ++r) {
+                mix_all(k, out.data(), voices);
+            }
+            rounds += 100;
+            now = SDL_GetPerformanceCounter();
+        } while((now - start)/freq < bench_seconds);
+        const double seconds = (now - start)/freq;
+        const double mixed = double(rounds)*num_voices*buffer_samples;
+        printf("%-8s %8.1f M samples/s\n", k.name, mixed/seconds/1e6);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,164 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#include"mixkernels.hpp"
+#include<algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MIX_HAVE_X86
+#include<immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#define MIX_HAVE_NEON
+#include<arm_neon.h>
+#endif
+
+// MSVC allows intrinsics in any function, GCC and Clang need to be
+// told which functions may use instructions beyond the baseline.
+#if defined(__GNUC__)
+#define MIX_TARGET(x) __attribute__((target(x)))
+#else
+#define MIX_TARGET(x)
+#endif
+
+namespace {
+
+void add_scalar(Sint16 *out, const Sint16 *in, int samples, int left, int right) {
+    for(int i=0; i<samples; ++i) {
+        const int volume = (i & 1) ? right : left;
+        const int mixed = out[i] + ((in[i]*volume) >> 7);
+        out[i] = Sint16(std::clamp(mixed, -32768, 32767));
+    }
+}
+
+void scale_scalar(Sint16 *buf, int samples, int volume) {
+    for(int i=0; i<samples; ++i) {
+        buf[i] = Sint16((buf[i]*volume) >> 7);
+    }
+}
+
+#ifdef MIX_HAVE_X86
+
+// The 16x16 bit products are widened to 32 bits so that the results
+// are bit identical to the scalar version.
+MIX_TARGET("sse2") inline __m128i scale8_sse2(__m128i x, __m128i vol) {
+    const __m128i lo = _mm_mullo_epi16(x, vol);
+    const __m128i hi = _mm_mulhi_epi16(x, vol);
+    const __m128i p0 = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 7);
+    const __m128i p1 = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 7);
+    return _mm_packs_epi32(p0, p1);
+}
+
+MIX_TARGET("sse2") void add_sse2(Sint16 *out, const Sint16 *in, int samples, int left, int right) {
+    const Sint16 l = Sint16(left);
+    const Sint16 r = Sint16(right);
+    const __m128i vol = _mm_set_epi16(r, l, r, l, r, l, r, l);
+    int i = 0;
+    for(; i+8 <= samples; i+=8) {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        const __m128i o = _mm_loadu_si128(reinterpret_cast<const __m128i*>(out + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_adds_epi16(o, scale8_sse2(x, vol)));
+    }
+    add_scalar(out + i, in + i, samples - i, left, right);
+}
+
+MIX_TARGET("sse2") void scale_sse2(Sint16 *buf, int samples, int volume) {
+    const __m128i vol = _mm_set1_epi16(Sint16(volume));
+    int i = 0;
+    for(; i+8 <= samples; i+=8) {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(buf + i), scale8_sse2(x, vol));
+    }
+    scale_scalar(buf + i, samples - i, volume);
+}
+
+// Unpack and pack both work within 128 bit lanes, so sample order is
+// preserved without any extra shuffles.
+MIX_TARGET("avx2") inline __m256i scale16_avx2(__m256i x, __m256i vol) {
+    const __m256i lo = _mm256_mullo_epi16(x, vol);
+    const __m256i hi = _mm256_mulhi_epi16(x, vol);
+    const __m256i p0 = _mm256_srai_epi32(_mm256_unpacklo_epi16(lo, hi), 7);
+    const __m256i p1 = _mm256_srai_epi32(_mm256_unpackhi_epi16(lo, hi), 7);
+    return _mm256_packs_epi32(p0, p1);
+}
+
+MIX_TARGET("avx2") void add_avx2(Sint16 *out, const Sint16 *in, int samples, int left, int right) {
+    const Sint16 l = Sint16(left);
+    const Sint16 r = Sint16(right);
+    const __m256i vol = _mm256_set_epi16(r, l, r, l, r, l, r, l, r, l, r, l, r, l, r, l);
+    int i = 0;
+    for(; i+16 <= samples; i+=16) {
+        const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        const __m256i o = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(out + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_adds_epi16(o, scale16_avx2(x, vol)));
+    }
+    add_scalar(out + i, in + i, samples - i, left, right);
+}
+
+MIX_TARGET("avx2") void scale_avx2(Sint16 *buf, int samples, int volume) {
+    const __m256i vol = _mm256_set1_epi16(Sint16(volume));
+    int i = 0;
+    for(; i+16 <= samples; i+=16) {
+        const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(buf + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(buf + i), scale16_avx2(x, vol));
+    }
+    scale_scalar(buf + i, samples - i, volume);
+}
+
+#endif
+
+#ifdef MIX_HAVE_NEON
+
+inline int16x8_t scale8_neon(int16x8_t x, int16x4_t vol) {
+    const int16x4_t lo = vshrn_n_s32(vmull_s16(vget_low_s16(x), vol), 7);
+    const int16x4_t hi = vshrn_n_s32(vmull_s16(vget_high_s16(x), vol), 7);
+    return vcombine_s16(lo, hi);
+}
+
+void add_neon(Sint16 *out, const Sint16 *in, int samples, int left, int right) {
+    const Sint16 lr[4] = {Sint16(left), Sint16(right), Sint16(left), Sint16(right)};
+    const int16x4_t vol = vld1_s16(lr);
+    int i = 0;
+    for(; i+8 <= samples; i+=8) {
+        const int16x8_t x = vld1q_s16(in + i);
+        const int16x8_t o = vld1q_s16(out + i);
+        vst1q_s16(out + i, vqaddq_s16(o, scale8_neon(x, vol)));
+    }
+    add_scalar(out + i, in + i, samples - i, left, right);
+}
+
+void scale_neon(Sint16 *buf, int samples, int volume) {
+    const int16x4_t vol = vdup_n_s16(Sint16(volume));
+    int i = 0;
+    for(; i+8 <= samples; i+=8) {
+        vst1q_s16(buf + i, scale8_neon(vld1q_s16(buf + i), vol));
+    }
+    scale_scalar(buf + i, samples - i, volume);
+}
+
+#endif
+
+}
+
+std::vector<mix_kernel> available_mix_kernels() {
+    std::vector<mix_kernel> kernels{{"scalar", add_scalar, scale_scalar}};
+#ifdef MIX_HAVE_X86
+    if(SDL_HasSSE2()) {
+        kernels.push_back(mix_kernel{"sse2", add_sse2, scale_sse2});
+    }
+    if(SDL_HasAVX2()) {
+        kernels.push_back(mix_kernel{"avx2", add_avx2, scale_avx2});
+    }
+#endif
+#ifdef MIX_HAVE_NEON
+    if(SDL_HasNEON()) {
+        kernels.push_back(mix_kernel{"neon", add_neon, scale_neon});
+    }
+#endif
+    return kernels;
+}
+
+mix_kernel select_mix_kernel() {
+    return available_mix_kernels().back();
+}
@@ -0,0 +1,25 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include<SDL.h>
+#include<vector>
+
+// out[i] = saturate(out[i] + in[i]*volume/128), where volume is left
+// for even i and right for odd i. For interleaved stereo that pans,
+// otherwise pass the same volume twice. Volumes are 0-128.
+typedef void (*mix_add_func)(Sint16 *out, const Sint16 *in, int samples, int left, int right);
+// buf[i] = buf[i]*volume/128. Volume is 0-128.
+typedef void (*mix_scale_func)(Sint16 *buf, int samples, int volume);
+
+struct mix_kernel {
+    const char *name;
+    mix_add_func add;
+    mix_scale_func scale;
+};
+
+// Every kernel the current CPU can run, scalar first.
+std::vector<mix_kernel> available_mix_kernels();
+// The fastest kernel the current CPU can run.
+mix_kernel select_mix_kernel();
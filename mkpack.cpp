@@ -0,0 +1,211 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+// Converts the files in res/ into a single asset pack. Run at build time.
+
+#include<SDL.h>
+#include<SDL_image.h>
+#include<SDL_mixer.h>
+#include"assetpack.hpp"
+#include"atlas.hpp"
+#include"compressedtex.hpp"
+#include"loader.hpp"
+#include"workerpool.hpp"
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<string>
+#include<vector>
+
+namespace {
+
+const Uint32 pack_pixel_format = SDL_PIXELFORMAT_ARGB8888;
+
+bool has_suffix(const std::string &s, const char *suffix) {
+    const size_t len = strlen(suffix);
+    return s.size() >= len && s.compare(s.size() - len, len, suffix) == 0;
+}
+
+bool is_sound(const std::string &s) {
+    return has_suffix(s, ".wav") || has_suffix(s, ".ogg");
+}
+
+// Assets are looked up with the same relative paths the app uses.
+std::string asset_name(const std::string &path) {
+    const auto slash = path.find_last_of("/\\");
+    return "res/" + (slash == std::string::npos ? path : path.substr(slash + 1));
+}
+
+pack_entry make_entry(const std::string &name, pack_entry_type type) {
+    pack_entry e;
+    memset(&e, 0, sizeof(e));
+    if(name.size() >= sizeof(e.name)) {
+        printf("Asset name %s is too long.\n", name.c_str());
+        std::exit(1);
+    }
+    memcpy(e.name, name.c_str(), name.size());
+    e.type = type;
+    return e;
+}
+
+void set_source(pack_entry &e, const char *fname) {
+    const auto bytes = read_file(fname);
+    e.source_size = bytes.size();
+    e.source_hash = content_hash(bytes.data(), bytes.size());
+}
+
+uint64_t align(uint64_t v) {
+    return (v + pack_alignment - 1) & ~(pack_alignment - 1);
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 3) {
+        printf("%s <output file> <asset files>\n", argv[0]);
+        return 1;
+    }
+    // Only the decoders and the format conversion are needed, not an
+    // actual sound card.
+    SDL_SetHint(SDL_HINT_AUDIODRIVER, "dummy");
+    if(SDL_Init(SDL_INIT_AUDIO) != 0) {
+        printf("Could not initialize SDL: %s\n", SDL_GetError());
+        return 1;
+    }
+    IMG_Init(IMG_INIT_PNG | IMG_INIT_JPG | IMG_INIT_TIF);
+    Mix_Init(MIX_INIT_OGG);
+    if(Mix_OpenAudio(mix_frequency, mix_format, mix_channels, 1024) == -1) {
+        printf("Mix_OpenAudio: %s\n", Mix_GetError());
+        return 1;
+    }
+    // The sounds are converted to what was actually opened, which is
+    // not necessarily what was asked for.
+    int audio_freq;
+    Uint16 audio_format;
+    int audio_channels;
+    if(!Mix_QuerySpec(&audio_freq, &audio_format, &audio_channels)) {
+        printf("Mix_QuerySpec: %s\n", Mix_GetError());
+        return 1;
+    }
+    std::vector<std::string> image_names, sound_names;
+    std::vector<const char*> image_files, sound_files;
+    for(int i=2; i<argc; ++i) {
+        if(is_sound(argv[i])) {
+            sound_files.push_back(argv[i]);
+            sound_names.push_back(asset_name(argv[i]));
+        } else {
+            image_files.push_back(argv[i]);
+            image_names.push_back(asset_name(argv[i]));
+        }
+    }
+
+    std::vector<pack_entry> entries;
+    std::vector<const void*> blobs;
+    std::vector<std::vector<Uint8>> compressed;
+    {
+        workerpool pool;
+        decoded_assets assets(pool, image_files, sound_files);
+        atlas_layout layout;
+        auto pages = compose_pages(assets.images, atlas_max_size, pack_pixel_format, layout);
+        for(auto *p : pages) {
+            auto e = make_entry("", PACK_PAGE);
+            e.format_or_page = pack_pixel_format;
+            e.w = p->w;
+            e.h = p->h;
+            e.pitch = p->pitch;
+            e.size = uint64_t(p->pitch)*p->h;
+            entries.push_back(e);
+            blobs.push_back(p->pixels);
+        }
+        // Pages are powers of two, so they always split into BC blocks.
+        compressed.reserve(pages.size());
+        for(size_t i=0; i<pages.size(); ++i) {
+            const auto *p = pages[i];
+            if(p->w % 4 != 0 || p->h % 4 != 0) {
+                continue;
+            }
+            compressed.push_back(encode_bc3(p->pixels, p->w, p->h, p->pitch));
+            auto e = make_entry("", PACK_PAGE_BC3);
+            e.format_or_page = format_bc3;
+            e.page = uint32_t(i);
+            e.w = p->w;
+            e.h = p->h;
+            e.size = compressed.back().size();
+            entries.push_back(e);
+            blobs.push_back(compressed.back().data());
+        }
+        for(size_t i=0; i<image_names.size(); ++i) {
+            auto e = make_entry(image_names[i], PACK_SPRITE);
+            e.format_or_page = uint32_t(layout.page_of[i]);
+            e.x = layout.rects[i].x;
+            e.y = layout.rects[i].y;
+            e.w = layout.rects[i].w;
+            e.h = layout.rects[i].h;
+            set_source(e, image_files[i]);
+            entries.push_back(e);
+            blobs.push_back(nullptr);
+        }
+        for(size_t i=0; i<sound_names.size(); ++i) {
+            if(!assets.sounds[i]) {
+                auto e = make_entry(sound_names[i], PACK_STREAM);
+                e.size = assets.encoded[i].size();
+                set_source(e, sound_files[i]);
+                entries.push_back(e);
+                blobs.push_back(assets.encoded[i].data());
+                continue;
+            }
+            auto e = make_entry(sound_names[i], PACK_SOUND);
+            e.size = assets.sounds[i]->alen;
+            set_source(e, sound_files[i]);
+            entries.push_back(e);
+            blobs.push_back(assets.sounds[i]->abuf);
+        }
+
+        uint64_t offset = align(sizeof(pack_header) + entries.size()*sizeof(pack_entry));
+        for(auto &e : entries) {
+            if(e.size > 0) {
+                e.offset = offset;
+                offset = align(offset + e.size);
+            }
+        }
+
+        pack_header h;
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, pack_magic, sizeof(pack_magic));
+        h.version = pack_version;
+        h.byte_order = pack_byte_order_mark;
+        h.num_entries = uint32_t(entries.size());
+        h.audio_freq = audio_freq;
+        h.audio_format = audio_format;
+        h.audio_channels = uint16_t(audio_channels);
+
+        FILE *f = fopen(argv[1], "wb");
+        if(!f) {
+            printf("Could not open %s for writing.\n", argv[1]);
+            return 1;
+        }
+        fwrite(&h, sizeof(h), 1, f);
+        fwrite(entries.data(), sizeof(pack_entry), entries.size(), f);
+        const char zeros[pack_alignment] = {};
+        for(size_t i=0; i<entries.size(); ++i) {
+            if(entries[i].size == 0) {
+                continue;
+            }
+            const long pos = ftell(f);
+            fwrite(zeros, 1, size_t(entries[i].offset - uint64_t(pos)), f);
+            fwrite(blobs[i], 1, size_t(entries[i].size), f);
+        }
+        if(fclose(f) != 0) {
+            printf("Writing %s failed.\n", argv[1]);
+            return 1;
+        }
+        for(auto *p : pages) {
+            SDL_FreeSurface(p);
+        }
+    }
+    Mix_CloseAudio();
+    Mix_Quit();
+    IMG_Quit();
+    SDL_Quit();
+    return 0;
+}
@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+// Compares the accuracy and speed of the ways motion can be evaluated.
+
+#include<SDL.h>
+#include"entities.hpp"
+#include"motiontables.hpp"
+#include<algorithm>
+#include<cmath>
+#include<cstdio>
+
+namespace {
+
+const size_t num_entities = 1 << 20;
+const int accuracy_points = 1 << 20;
+const double bench_seconds = 0.5;
+
+const motion_params motion{480, 270, 384, 216};
+
+struct method {
+    const char *name;
+    float (*sin_turns)(float);
+};
+
+float libm_sin_turns(float turns) {
+    return std::sin(6.28318531f*turns);
+}
+
+template<size_t N>
+float table_sin_turns(float turns) {
+    return sine_table<N>::lookup(turns);
+}
+
+// Largest error against double precision over two full turns, the
+// range the y coordinate needs.
+double max_error(float (*f)(float)) {
+    double worst = 0;
+    for(int i=0; i<accuracy_points; ++i) {
+        const float t = 2.0f*i/accuracy_points;
+        const double exact = std::sin(6.283185307179586*double(t));
+        worst = std::max(worst, std::fabs(f(t) - exact));
+    }
+    return worst;
+}
+
+// Largest distance from the libm positions on the real update path.
+double max_deviation(motion_eval eval, const entity_store &ents, const render_list &reference) {
+    motion_params m = motion;
+    m.eval = eval;
+    render_list out;
+    out.resize(ents.size());
+    update_positions(ents, out, 0, ents.size(), 0.3f, m);
+    double worst = 0;
+    for(size_t i=0; i<ents.size(); ++i) {
+        worst = std::max({worst, double(std::fabs(out.x[i] - reference.x[i])),
+                double(std::fabs(out.y[i] - reference.y[i]))});
+    }
+    return worst;
+}
+
+double entities_per_second(motion_eval eval, const entity_store &ents, render_list &out) {
+    motion_params m = motion;
+    m.eval = eval;
+    const double freq = double(SDL_GetPerformanceFrequency());
+    long long rounds = 0;
+    const auto start = SDL_GetPerformanceCounter();
+    Uint64 now;
+    do {
+        update_positions(ents, out, 0, ents.size(), float(rounds % 100)/100, m);
+        ++rounds;
+        now = SDL_GetPerformanceCounter();
+    } while((now - start)/freq < bench_seconds);
+    return double(rounds)*ents.size()/((now - start)/freq);
+}
+
+}
+
+int main(int, char **) {
+    const method methods[] = {
+        {"libm", libm_sin_turns},
+        {"approx", sin_turns},
+        {"lut256", table_sin_turns<256>},
+        {"lut1024", table_sin_turns<1024>},
+        {"lut4096", table_sin_turns<4096>},
+    };
+    for(const auto &m : methods) {
+        printf("%-8s max error %.2e, %.4f px at %g px amplitude\n", m.name, max_error(m.sin_turns),
+                max_error(m.sin_turns)*motion.amp_x, double(motion.amp_x));
+    }
+    entity_store ents;
+    for(size_t i=0; i<num_entities; ++i) {
+        ents.add(float(i)/num_entities, 0);
+    }
+    render_list out;
+    out.resize(ents.size());
+    render_list reference;
+    reference.resize(ents.size());
+    motion_params libm_motion = motion;
+    libm_motion.eval = motion_eval::libm;
+    update_positions(ents, reference, 0, ents.size(), 0.3f, libm_motion);
+    const struct {
+        const char *name;
+        motion_eval eval;
+    } evals[] = {
+        {"libm", motion_eval::libm},
+        {"approx", motion_eval::approx},
+        {"lut", motion_eval::lut},
+    };
+    for(const auto &e : evals) {
+        printf("%-8s %8.1f M entities/s, at most %.4f px from libm\n", e.name,
+                entities_per_second(e.eval, ents, out)/1e6, max_deviation(e.eval, ents, reference));
+    }
+    return 0;
+}
@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include<array>
+#include<cmath>
+#include<cstddef>
+
+// Entries per turn in the sine table used for motion. Linear
+// interpolation between them is accurate to about 5e-6.
+const size_t motion_lut_size = 1024;
+
+namespace motion_detail {
+
+constexpr double two_pi = 6.28318530717958647692;
+
+// sin(2*pi*turns) for turns in [0, 1], to double precision. std::sin
+// can not be used in constant expressions.
+constexpr double sin_turns_exact(double turns) {
+    double u = turns > 0.5 ? turns - 1.0 : turns;
+    if(u > 0.25) {
+        u = 0.5 - u;
+    } else if(u < -0.25) {
+        u = -0.5 - u;
+    }
+    const double x = two_pi*u;
+    double term = x;
+    double sum = x;
+    for(int k=1; k<=12; ++k) {
+        term *= -x*x/((2*k)*(2*k + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+template<size_t N>
+constexpr std::array<float, N + 1> make_sine_table() {
+    std::array<float, N + 1> t{};
+    for(size_t i=0; i<=N; ++i) {
+        t[i] = float(sin_turns_exact(double(i)/N));
+    }
+    return t;
+}
+
+}
+
+// sin(2*pi*turns) from a table of N entries per turn generated at
+// compile time. The extra last entry repeats the first so that
+// interpolation never wraps.
+template<size_t N>
+struct sine_table {
+    static_assert(N >= 4 && (N & (N - 1)) == 0, "Table size must be a power of two.");
+
+    static constexpr std::array<float, N + 1> values = motion_detail::make_sine_table<N>();
+
+    // Turns must be well within the range of int once scaled by N.
+    static float lookup(float turns) {
+        const float f = turns*N;
+        // Truncation plus a correction is floor(), without a libm call.
+        int whole = int(f);
+        whole -= f < float(whole);
+        const float frac = f - float(whole);
+        const size_t i = size_t(whole) & (N - 1);
+        return values[i] + frac*(values[i + 1] - values[i]);
+    }
+};
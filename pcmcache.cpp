@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#include"pcmcache.hpp"
+#include<cstdio>
+#include<cstring>
+#include<functional>
+#include<thread>
+
+namespace {
+
+const char cache_magic[8] = {'S', 'D', 'L', 'T', 'P', 'C', 'M', '1'};
+
+struct cache_header {
+    char magic[8];
+    int32_t version;
+    int32_t freq;
+    int32_t channels;
+    int32_t unused;
+    uint64_t key;
+    uint64_t samples;
+};
+
+}
+
+pcm_cache::pcm_cache() {
+    char *d = SDL_GetPrefPath("jpakkane", "sdltest");
+    if(d) {
+        dir = d;
+        SDL_free(d);
+    }
+}
+
+std::string pcm_cache::file(uint64_t key, pcm_format format) const {
+    char name[64];
+    snprintf(name, sizeof(name), "pcm-%016llx-%d-%d.raw", (unsigned long long)key, format.freq, format.channels);
+    return dir + name;
+}
+
+bool pcm_cache::load(uint64_t key, pcm_format format, std::vector<Sint16> &pcm) const {
+    if(dir.empty()) {
+        return false;
+    }
+    FILE *f = fopen(file(key, format).c_str(), "rb");
+    if(!f) {
+        return false;
+    }
+    cache_header h;
+    bool ok = fread(&h, sizeof(h), 1, f) == 1 &&
+        memcmp(h.magic, cache_magic, sizeof(cache_magic)) == 0 &&
+        h.version == resampler_version && h.freq == format.freq &&
+        h.channels == format.channels && h.key == key;
+    if(ok) {
+        // A truncated or overlong file is as good as missing.
+        fseek(f, 0, SEEK_END);
+        ok = uint64_t(ftell(f)) == sizeof(h) + h.samples*sizeof(Sint16);
+        fseek(f, long(sizeof(h)), SEEK_SET);
+    }
+    if(ok) {
+        pcm.resize(size_t(h.samples));
+        ok = fread(pcm.data(), sizeof(Sint16), pcm.size(), f) == pcm.size();
+    }
+    fclose(f);
+    return ok;
+}
+
+bool pcm_cache::store(uint64_t key, pcm_format format, const std::vector<Sint16> &pcm) const {
+    if(dir.empty()) {
+        return false;
+    }
+    // Written under a name of its own and renamed, so that a reader
+    // never sees a partial file.
+    const std::string fname = file(key, format);
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%zx.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()));
+    const std::string tmp = fname + suffix;
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if(!f) {
+        printf("Could not write %s.\n", tmp.c_str());
+        return false;
+    }
+    cache_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, cache_magic, sizeof(cache_magic));
+    h.version = resampler_version;
+    h.freq = format.freq;
+    h.channels = format.channels;
+    h.key = key;
+    h.samples = pcm.size();
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+        fwrite(pcm.data(), sizeof(Sint16), pcm.size(), f) == pcm.size();
+    ok = fclose(f) == 0 && ok;
+    remove(fname.c_str());
+    if(!ok || rename(tmp.c_str(), fname.c_str()) != 0) {
+        remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
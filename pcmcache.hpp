@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include"resampler.hpp"
+#include<cstdint>
+#include<string>
+#include<vector>
+
+// Sounds converted to the device format, stored in the user's SDL
+// preference directory so that each one is resampled only once. An
+// entry is keyed by the content_hash of the source file and by the
+// output format. Safe to use from several threads at once.
+struct pcm_cache {
+    pcm_cache();
+
+    // Returns false if there is no valid entry.
+    bool load(uint64_t key, pcm_format format, std::vector<Sint16> &pcm) const;
+    bool store(uint64_t key, pcm_format format, const std::vector<Sint16> &pcm) const;
+
+    bool usable() const { return !dir.empty(); }
+
+private:
+    std::string file(uint64_t key, pcm_format format) const;
+
+    std::string dir;
+};
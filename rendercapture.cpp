@@ -0,0 +1,188 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#include"rendercapture.hpp"
+#include"loader.hpp"
+#include<cassert>
+#include<cstring>
+
+namespace {
+
+const char record_magic[8] = {'S', 'D', 'L', 'T', 'R', 'E', 'C', '1'};
+
+struct record_header {
+    char magic[8];
+    Uint32 width;
+    Uint32 height;
+};
+
+// Everything is drawn at this size. The recording keeps it anyway so
+// it stays valid if that changes.
+const size_t draw_record_size = sizeof(Uint16) + 4*sizeof(float);
+
+}
+
+render_recorder::render_recorder(const char *fname, int width, int height) : f(fopen(fname, "wb")) {
+    if(!f) {
+        printf("Could not open %s for writing.\n", fname);
+        return;
+    }
+    record_header h;
+    memcpy(h.magic, record_magic, sizeof(h.magic));
+    h.width = Uint32(width);
+    h.height = Uint32(height);
+    fwrite(&h, sizeof(h), 1, f);
+}
+
+render_recorder::~render_recorder() {
+    if(f) {
+        fwrite(buf.data(), 1, buf.size(), f);
+        fclose(f);
+    }
+}
+
+void render_recorder::put(const void *data, size_t size) {
+    const auto *p = static_cast<const Uint8*>(data);
+    buf.insert(buf.end(), p, p + size);
+}
+
+void render_recorder::clear(SDL_Color c) {
+    if(!f) {
+        return;
+    }
+    draw_run = 0;
+    const Uint8 cmd[5] = {REC_CLEAR, c.r, c.g, c.b, c.a};
+    put(cmd, sizeof(cmd));
+}
+
+void render_recorder::draw(int sprite_id, const SDL_FRect &dst) {
+    if(!f) {
+        return;
+    }
+    assert(sprite_id >= 0 && sprite_id <= 0xFFFF);
+    Uint32 count = 0;
+    if(draw_run == 0) {
+        const Uint8 op = REC_DRAW;
+        put(&op, 1);
+        draw_run = buf.size();
+        put(&count, sizeof(count));
+    }
+    memcpy(&count, buf.data() + draw_run, sizeof(count));
+    ++count;
+    memcpy(buf.data() + draw_run, &count, sizeof(count));
+    Uint8 rec[draw_record_size];
+    const Uint16 id = Uint16(sprite_id);
+    memcpy(rec, &id, sizeof(id));
+    memcpy(rec + sizeof(id), &dst, 4*sizeof(float));
+    put(rec, sizeof(rec));
+}
+
+void render_recorder::flush() {
+    if(!f) {
+        return;
+    }
+    draw_run = 0;
+    const Uint8 op = REC_FLUSH;
+    put(&op, 1);
+}
+
+void render_recorder::present(double frame_seconds, float alpha, int64_t step) {
+    if(!f) {
+        return;
+    }
+    draw_run = 0;
+    const Uint8 op = REC_PRESENT;
+    put(&op, 1);
+    put(&frame_seconds, sizeof(frame_seconds));
+    put(&alpha, sizeof(alpha));
+    put(&step, sizeof(step));
+    fwrite(buf.data(), 1, buf.size(), f);
+    buf.clear();
+    ++frame_count;
+}
+
+bool render_replay::load(const char *fname) {
+    if(!try_read_file(fname, data)) {
+        printf("Could not read recording %s.\n", fname);
+        return false;
+    }
+    record_header h;
+    if(data.size() < sizeof(h) || memcmp(data.data(), record_magic, sizeof(record_magic)) != 0) {
+        printf("%s is not a render recording.\n", fname);
+        return false;
+    }
+    memcpy(&h, data.data(), sizeof(h));
+    rec_width = int(h.width);
+    rec_height = int(h.height);
+    rewind();
+    return true;
+}
+
+void render_replay::rewind() {
+    pos = sizeof(record_header);
+    frame_count = 0;
+    draw_count = 0;
+    seconds = 0;
+    bad = false;
+}
+
+bool render_replay::get(void *out, size_t size) {
+    if(data.size() - pos < size) {
+        bad = true;
+        return false;
+    }
+    memcpy(out, data.data() + pos, size);
+    pos += size;
+    return true;
+}
+
+bool render_replay::next_frame(SDL_Renderer *rend, spritebatch &batch, const std::vector<sprite> &sprites) {
+    while(!bad && pos < data.size()) {
+        const Uint8 op = data[pos++];
+        if(op == REC_CLEAR) {
+            Uint8 c[4];
+            if(!get(c, sizeof(c))) {
+                break;
+            }
+            SDL_SetRenderDrawColor(rend, c[0], c[1], c[2], c[3]);
+            SDL_RenderClear(rend);
+        } else if(op == REC_DRAW) {
+            Uint32 count;
+            if(!get(&count, sizeof(count)) || (data.size() - pos)/draw_record_size < count) {
+                bad = true;
+                break;
+            }
+            for(Uint32 i=0; i<count; ++i) {
+                Uint16 id;
+                SDL_FRect dst;
+                get(&id, sizeof(id));
+                get(&dst, 4*sizeof(float));
+                if(id >= sprites.size()) {
+                    bad = true;
+                    break;
+                }
+                batch.add(sprites[id].tex, &sprites[id].src, dst);
+                ++draw_count;
+            }
+        } else if(op == REC_FLUSH) {
+            batch.flush(rend);
+        } else if(op == REC_PRESENT) {
+            double frame_seconds;
+            float alpha;
+            int64_t step;
+            if(!get(&frame_seconds, sizeof(frame_seconds)) || !get(&alpha, sizeof(alpha)) ||
+                    !get(&step, sizeof(step))) {
+                break;
+            }
+            batch.flush(rend);
+            seconds += frame_seconds;
+            ++frame_count;
+            return true;
+        } else {
+            bad = true;
+        }
+    }
+    // A truncated last frame is still submitted so the batch is empty.
+    batch.flush(rend);
+    return false;
+}
@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include<SDL.h>
+#include"atlas.hpp"
+#include"spritebatch.hpp"
+#include<cstdint>
+#include<cstdio>
+#include<vector>
+
+// A recording is a short header followed by commands, each an opcode
+// byte and its payload in host byte order:
+//   REC_CLEAR    r, g, b, a as bytes
+//   REC_DRAW     Uint32 count, then count times Uint16 sprite id and
+//                float x, y, w, h
+//   REC_PRESENT  double seconds since the previous present, float
+//                interpolation alpha, int64 simulation step
+//   REC_FLUSH    nothing, the draws so far are submitted before the
+//                next ones, as between layers
+// Sprites are recorded by id instead of texture, so a recording
+// replays with whatever assets are loaded.
+enum record_op : Uint8 {
+    REC_CLEAR = 1,
+    REC_DRAW = 2,
+    REC_PRESENT = 3,
+    REC_FLUSH = 4,
+};
+
+// Writes what render() submits to a file, one frame at a time.
+struct render_recorder {
+    // The size is that of the window being recorded.
+    render_recorder(const char *fname, int width, int height);
+    ~render_recorder();
+
+    render_recorder(const render_recorder &) = delete;
+    render_recorder& operator=(const render_recorder &) = delete;
+
+    bool ok() const { return f != nullptr; }
+
+    void clear(SDL_Color c);
+    void draw(int sprite_id, const SDL_FRect &dst);
+    void flush();
+    // Ends the frame and writes it out.
+    void present(double frame_seconds, float alpha, int64_t step);
+
+    size_t frames() const { return frame_count; }
+
+private:
+    void put(const void *data, size_t size);
+
+    FILE *f;
+    // Kept between frames so recording does not allocate once warm.
+    std::vector<Uint8> buf;
+    // Offset of the count of the draw run being appended to, or 0.
+    size_t draw_run = 0;
+    size_t frame_count = 0;
+};
+
+// Replays a recording frame by frame.
+struct render_replay {
+    bool load(const char *fname);
+
+    // Clears and draws the next frame, which the caller presents.
+    // Returns false at the end or if the data is corrupt.
+    bool next_frame(SDL_Renderer *rend, spritebatch &batch, const std::vector<sprite> &sprites);
+    void rewind();
+
+    int width() const { return rec_width; }
+    int height() const { return rec_height; }
+    bool corrupt() const { return bad; }
+    size_t frames() const { return frame_count; }
+    size_t draws() const { return draw_count; }
+    // Wall clock length of the recorded session.
+    double recorded_seconds() const { return seconds; }
+
+private:
+    bool get(void *out, size_t size);
+
+    std::vector<Uint8> data;
+    int rec_width = 0;
+    int rec_height = 0;
+    size_t pos = 0;
+    size_t frame_count = 0;
+    size_t draw_count = 0;
+    double seconds = 0;
+    bool bad = false;
+};
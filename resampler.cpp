@@ -0,0 +1,205 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#include"resampler.hpp"
+#include"soundstream.hpp"
+#include<algorithm>
+#include<cmath>
+#include<cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RESAMPLER_HAVE_SSE2
+#include<emmintrin.h>
+#elif defined(__ARM_NEON)
+#define RESAMPLER_HAVE_NEON
+#include<arm_neon.h>
+#endif
+
+namespace {
+
+// Filter quality. Zero crossings per side at full bandwidth, how much
+// of the lower Nyquist frequency is passed and the Kaiser window shape.
+const int zero_crossings = 16;
+const double passband = 0.95;
+const double kaiser_beta = 8.6;
+
+const double pi = 3.14159265358979323846;
+
+uint64_t gcd(uint64_t a, uint64_t b) {
+    while(b) {
+        const uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Modified Bessel function of the first kind, order zero.
+double bessel_i0(double x) {
+    double sum = 1;
+    double term = 1;
+    for(int k=1; k<50; ++k) {
+        term *= (x/(2*k))*(x/(2*k));
+        sum += term;
+        if(term < sum*1e-17) {
+            break;
+        }
+    }
+    return sum;
+}
+
+// n is a multiple of four.
+inline float dot(const float *a, const float *b, int n) {
+#if defined(RESAMPLER_HAVE_SSE2)
+    __m128 acc = _mm_setzero_ps();
+    for(int i=0; i<n; i+=4) {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    return _mm_cvtss_f32(acc);
+#elif defined(RESAMPLER_HAVE_NEON)
+    float32x4_t acc = vdupq_n_f32(0);
+    for(int i=0; i<n; i+=4) {
+        acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+    }
+    const float32x2_t sum = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    return vget_lane_f32(vpadd_f32(sum, sum), 0);
+#else
+    float acc[4] = {0, 0, 0, 0};
+    for(int i=0; i<n; i+=4) {
+        for(int j=0; j<4; ++j) {
+            acc[j] += a[i + j]*b[i + j];
+        }
+    }
+    return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+#endif
+}
+
+Sint16 to_s16(float v) {
+    const float scaled = v*32767.0f;
+    return Sint16(std::lrint(std::min(32767.0f, std::max(-32768.0f, scaled))));
+}
+
+}
+
+sinc_resampler::sinc_resampler(int in_rate, int out_rate) {
+    const uint64_t g = gcd(uint64_t(in_rate), uint64_t(out_rate));
+    up = uint64_t(out_rate)/g;
+    down = uint64_t(in_rate)/g;
+    phases = int(std::min<uint64_t>(up, max_phases));
+    // When downsampling the cutoff moves down to the output's Nyquist
+    // frequency and the filter gets longer to match.
+    const double cutoff = passband*std::min(1.0, double(out_rate)/in_rate);
+    const int half = int(std::ceil(zero_crossings/cutoff));
+    num_taps = (2*half + 3) & ~3;
+    // Padding taps go at the start, run() puts the output position
+    // right after the middle tap.
+    const int centre = num_taps/2;
+    table.resize(size_t(phases)*num_taps);
+    const double i0_beta = bessel_i0(kaiser_beta);
+    for(int p=0; p<phases; ++p) {
+        const double frac = double(p)/phases;
+        float *row = table.data() + size_t(p)*num_taps;
+        double sum = 0;
+        for(int k=0; k<num_taps; ++k) {
+            // Distance of the input sample from the output position.
+            const double d = k - centre + 1 - frac;
+            double h = 0;
+            if(std::fabs(d) < half) {
+                const double x = cutoff*d;
+                const double sinc = x == 0 ? 1.0 : std::sin(pi*x)/(pi*x);
+                const double r = d/half;
+                h = cutoff*sinc*bessel_i0(kaiser_beta*std::sqrt(1 - r*r))/i0_beta;
+            }
+            row[k] = float(h);
+            sum += h;
+        }
+        // Unity gain at DC for every phase.
+        for(int k=0; k<num_taps; ++k) {
+            row[k] = float(row[k]/sum);
+        }
+    }
+}
+
+size_t sinc_resampler::output_frames(size_t in_frames) const {
+    return size_t((uint64_t(in_frames)*up + down - 1)/down);
+}
+
+void sinc_resampler::run(const float *in, size_t in_frames, int stride, float *out, int out_stride) const {
+    // Padded with silence so that every output sample sees num_taps inputs.
+    const int half = num_taps/2;
+    std::vector<float> padded(in_frames + num_taps, 0.0f);
+    for(size_t i=0; i<in_frames; ++i) {
+        padded[i + half - 1] = in[i*stride];
+    }
+    const size_t frames = output_frames(in_frames);
+    for(size_t n=0; n<frames; ++n) {
+        const uint64_t pos = n*down;
+        const size_t idx = size_t(pos/up);
+        const uint64_t rem = pos % up;
+        const size_t phase = phases == int(up) ? size_t(rem) : size_t(rem*phases/up);
+        out[n*out_stride] = dot(padded.data() + idx, table.data() + phase*num_taps, num_taps);
+    }
+}
+
+bool convert_sound(const Uint8 *data, size_t size, pcm_format out, std::vector<Sint16> &pcm) {
+    std::vector<Sint16> vorbis;
+    int rate;
+    int channels;
+    SDL_AudioFormat format = AUDIO_S16SYS;
+    Uint8 *wav = nullptr;
+    Uint32 wav_len = 0;
+    const Uint8 *src;
+    size_t src_len;
+    if(decode_vorbis(data, size, vorbis, rate, channels)) {
+        src = reinterpret_cast<const Uint8*>(vorbis.data());
+        src_len = vorbis.size()*sizeof(Sint16);
+    } else {
+        SDL_AudioSpec spec;
+        if(!SDL_LoadWAV_RW(SDL_RWFromConstMem(data, int(size)), 1, &spec, &wav, &wav_len)) {
+            return false;
+        }
+        rate = spec.freq;
+        channels = spec.channels;
+        format = spec.format;
+        src = wav;
+        src_len = wav_len;
+    }
+    // SDL converts the sample format and channel layout, but not the
+    // rate, which is what it does worst.
+    SDL_AudioCVT cvt;
+    if(SDL_BuildAudioCVT(&cvt, format, Uint8(channels), rate, AUDIO_F32SYS, Uint8(out.channels), rate) < 0) {
+        SDL_FreeWAV(wav);
+        return false;
+    }
+    std::vector<Uint8> work(src_len*size_t(cvt.len_mult));
+    memcpy(work.data(), src, src_len);
+    SDL_FreeWAV(wav);
+    cvt.buf = work.data();
+    cvt.len = int(src_len);
+    if(cvt.needed && SDL_ConvertAudio(&cvt) != 0) {
+        return false;
+    }
+    const size_t converted = cvt.needed ? size_t(cvt.len_cvt) : src_len;
+    const float *samples = reinterpret_cast<const float*>(work.data());
+    const size_t in_frames = converted/(sizeof(float)*out.channels);
+    if(rate == out.freq) {
+        pcm.resize(in_frames*out.channels);
+        for(size_t i=0; i<pcm.size(); ++i) {
+            pcm[i] = to_s16(samples[i]);
+        }
+        return true;
+    }
+    sinc_resampler rs(rate, out.freq);
+    const size_t out_frames = rs.output_frames(in_frames);
+    std::vector<float> resampled(out_frames*out.channels);
+    for(int c=0; c<out.channels; ++c) {
+        rs.run(samples + c, in_frames, out.channels, resampled.data() + c, out.channels);
+    }
+    pcm.resize(resampled.size());
+    for(size_t i=0; i<pcm.size(); ++i) {
+        pcm[i] = to_s16(resampled[i]);
+    }
+    return true;
+}
@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include<SDL.h>
+#include<cstddef>
+#include<cstdint>
+#include<vector>
+
+// Bumped whenever the conversion output changes, which invalidates
+// cached conversions.
+const int resampler_version = 1;
+
+// An output format of native signed 16 bit samples.
+struct pcm_format {
+    int freq;
+    int channels;
+};
+
+// Windowed sinc resampler for whole sounds. The ratio is kept as an
+// exact fraction, and while its numerator is small enough every
+// output sample has a filter phase of its own. Otherwise the nearest
+// of max_phases is used.
+struct sinc_resampler {
+    static const int max_phases = 1024;
+
+    sinc_resampler(int in_rate, int out_rate);
+
+    size_t output_frames(size_t in_frames) const;
+    // Resamples one channel of interleaved float data.
+    void run(const float *in, size_t in_frames, int stride, float *out, int out_stride) const;
+
+    int taps() const { return num_taps; }
+
+private:
+    uint64_t up;
+    uint64_t down;
+    int phases;
+    // A multiple of four so the dot products need no tail.
+    int num_taps;
+    // phases rows of num_taps coefficients.
+    std::vector<float> table;
+};
+
+// Decodes WAV or Ogg Vorbis data and converts it to the given format
+// with the resampler. Returns false if the data can not be decoded.
+bool convert_sound(const Uint8 *data, size_t size, pcm_format out, std::vector<Sint16> &pcm);
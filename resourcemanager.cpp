@@ -0,0 +1,487 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#include"resourcemanager.hpp"
+#include"audio.hpp"
+#include"loader.hpp"
+#include"texturedecoder.hpp"
+#include<algorithm>
+#include<cassert>
+#include<cstdio>
+#include<cstring>
+
+namespace {
+
+enum resource_kind : int {
+    RES_TEXTURE,
+    RES_SOUND,
+};
+
+enum load_state : int {
+    LOAD_EVICTED,
+    LOAD_PENDING,
+    // Texture size is known, waiting for the main thread to place it.
+    LOAD_OPENED,
+    LOAD_DECODED,
+    LOAD_READY,
+    LOAD_FAILED,
+};
+
+const int placeholder_size = 8;
+// Largest atlas page for loaded images. Bigger images get a page each.
+const int max_page_size = 2048;
+
+}
+
+struct resource_entry {
+    std::string path;
+    int kind;
+    int refs = 0;
+    std::atomic<int> state{LOAD_EVICTED};
+
+    // Written by the loading tasks before the state changes from
+    // LOAD_PENDING. Textures decode into pixels, which is either their
+    // slot in a locked page or staging that is then copied into it.
+    std::unique_ptr<texture_decoder> image;
+    void *pixels = nullptr;
+    std::vector<Uint8> staging;
+    int pitch = 0;
+    Mix_Chunk *chunk = nullptr;
+    std::vector<Uint8> encoded;
+
+    // Main thread only.
+    // A reload loads into a new entry that replaces this one when done.
+    resource_entry *replaces = nullptr;
+    bool reloading = false;
+    bool reload_again = false;
+    // Atlas page index or -1, and the slot in it.
+    int page = -1;
+    SDL_Rect slot{0, 0, 0, 0};
+    // Counted in the page's filling while it decodes into the lock.
+    bool in_lock = false;
+    int w = 0;
+    int h = 0;
+    size_t bytes = 0;
+    Uint64 last_frame = 0;
+};
+
+namespace {
+
+void decode_pixels(resource_entry &e, Uint32 format) {
+    const bool ok = e.image->decode(e.pixels, e.pitch, format);
+    e.image.reset();
+    e.state.store(ok ? LOAD_DECODED : LOAD_FAILED, std::memory_order_release);
+}
+
+void decode(resource_entry &e, double stream_seconds, const pcm_cache *cache) {
+    bool ok = false;
+    if(e.kind == RES_TEXTURE) {
+        e.image = std::make_unique<texture_decoder>();
+        ok = e.image->open(e.path.c_str());
+        e.state.store(ok ? LOAD_OPENED : LOAD_FAILED, std::memory_order_release);
+        return;
+    }
+    if(try_read_file(e.path.c_str(), e.encoded)) {
+        const double seconds = vorbis_seconds(e.encoded.data(), e.encoded.size());
+        if(seconds >= stream_seconds) {
+            ok = true;
+        } else {
+            e.chunk = load_sound(e.encoded, cache);
+            std::vector<Uint8>().swap(e.encoded);
+            ok = e.chunk;
+        }
+    }
+    e.state.store(ok ? LOAD_DECODED : LOAD_FAILED, std::memory_order_release);
+}
+
+// Textures are freed separately, see resource_manager::free_texture().
+void free_payload(resource_entry &e) {
+    e.image.reset();
+    std::vector<Uint8>().swap(e.staging);
+    Mix_FreeChunk(e.chunk);
+    e.chunk = nullptr;
+    std::vector<Uint8>().swap(e.encoded);
+}
+
+SDL_Texture* make_placeholder(SDL_Renderer *rend) {
+    SDL_Surface *s = SDL_CreateRGBSurfaceWithFormat(0, placeholder_size, placeholder_size, 32,
+            SDL_PIXELFORMAT_ARGB8888);
+    assert(s);
+    for(int y=0; y<placeholder_size; ++y) {
+        Uint32 *row = reinterpret_cast<Uint32*>(static_cast<Uint8*>(s->pixels) + y*s->pitch);
+        for(int x=0; x<placeholder_size; ++x) {
+            row[x] = ((x + y) & 1) ? 0xFFFF00FF : 0xFF000000;
+        }
+    }
+    SDL_Texture *t = SDL_CreateTextureFromSurface(rend, s);
+    SDL_FreeSurface(s);
+    return t;
+}
+
+}
+
+resource_handle::resource_handle(resource_entry *e) : entry(e) {
+    if(entry) {
+        ++entry->refs;
+    }
+}
+
+resource_handle::resource_handle(const resource_handle &o) : resource_handle(o.entry) {
+}
+
+resource_handle& resource_handle::operator=(const resource_handle &o) {
+    if(o.entry) {
+        ++o.entry->refs;
+    }
+    if(entry) {
+        --entry->refs;
+    }
+    entry = o.entry;
+    return *this;
+}
+
+resource_handle::~resource_handle() {
+    if(entry) {
+        --entry->refs;
+    }
+}
+
+resource_manager::resource_manager(SDL_Renderer *rend_, workerpool &pool_, double stream_seconds_,
+        const pcm_cache *cache_, audiocontrol *audio_) :
+        rend(rend_), pool(pool_), stream_seconds(stream_seconds_), cache(cache_), audio(audio_),
+        placeholder(make_placeholder(rend_)),
+        format(preferred_texture_format(rend_)), page_size(max_page_size) {
+    SDL_RendererInfo info;
+    if(SDL_GetRendererInfo(rend, &info) == 0 && info.max_texture_width > 0 && info.max_texture_height > 0) {
+        page_size = std::min({page_size, info.max_texture_width, info.max_texture_height});
+    }
+}
+
+// Handles must not outlive the manager.
+resource_manager::~resource_manager() {
+    pool.wait(group);
+    for(auto &kv : entries) {
+        free_payload(*kv.second);
+    }
+    for(auto &r : replacements) {
+        free_payload(*r);
+    }
+    for(auto &r : retired) {
+        Mix_FreeChunk(r.chunk);
+    }
+    for(auto &p : pages) {
+        if(p.pixels) {
+            SDL_UnlockTexture(p.tex);
+        }
+        SDL_DestroyTexture(p.tex);
+    }
+    SDL_DestroyTexture(placeholder);
+}
+
+resource_handle resource_manager::texture(const char *path) {
+    return get(path, RES_TEXTURE);
+}
+
+resource_handle resource_manager::sound(const char *path) {
+    return get(path, RES_SOUND);
+}
+
+resource_handle resource_manager::get(const char *path, int kind) {
+    auto it = entries.find(path);
+    if(it == entries.end()) {
+        auto e = std::make_unique<resource_entry>();
+        e->path = path;
+        e->kind = kind;
+        it = entries.emplace(e->path, std::move(e)).first;
+    }
+    auto &e = *it->second;
+    assert(e.kind == kind);
+    if(e.state.load(std::memory_order_relaxed) == LOAD_EVICTED) {
+        start_load(e);
+    }
+    return resource_handle(&e);
+}
+
+void resource_manager::start_load(resource_entry &e) {
+    e.state.store(LOAD_PENDING, std::memory_order_relaxed);
+    in_flight.push_back(&e);
+    resource_entry *p = &e;
+    const double stream = stream_seconds;
+    const pcm_cache *c = cache;
+    pool.submit(group, [p, stream, c] { decode(*p, stream, c); });
+}
+
+bool resource_manager::ready(const resource_handle &h) const {
+    return h.entry && h.entry->state.load(std::memory_order_relaxed) == LOAD_READY;
+}
+
+sprite resource_manager::get_sprite(const resource_handle &h) {
+    if(!ready(h)) {
+        return sprite{placeholder, SDL_Rect{0, 0, placeholder_size, placeholder_size}};
+    }
+    h.entry->last_frame = frame;
+    const auto &e = *h.entry;
+    return sprite{pages[size_t(e.page)].tex, SDL_Rect{e.slot.x, e.slot.y, e.w, e.h}};
+}
+
+sound_asset resource_manager::get_sound(const resource_handle &h) {
+    if(!ready(h)) {
+        return sound_asset{nullptr, encoded_sound{nullptr, 0}};
+    }
+    h.entry->last_frame = frame;
+    return sound_asset{h.entry->chunk, encoded_sound{h.entry->encoded.data(), h.entry->encoded.size()}};
+}
+
+void resource_manager::update() {
+    ++frame;
+    // A locked page is unlocked once everything in it has decoded.
+    for(auto *p : in_flight) {
+        if(p->in_lock && p->state.load(std::memory_order_acquire) != LOAD_PENDING) {
+            --pages[size_t(p->page)].filling;
+            p->in_lock = false;
+        }
+    }
+    for(auto &p : pages) {
+        if(p.pixels && p.filling == 0) {
+            SDL_UnlockTexture(p.tex);
+            p.pixels = nullptr;
+        }
+    }
+    for(size_t i=0; i<in_flight.size();) {
+        auto &e = *in_flight[i];
+        const int state = e.state.load(std::memory_order_acquire);
+        if(state == LOAD_PENDING) {
+            ++i;
+            continue;
+        }
+        if(state == LOAD_OPENED) {
+            if(place_texture(e)) {
+                e.state.store(LOAD_PENDING, std::memory_order_relaxed);
+                resource_entry *p = &e;
+                const Uint32 f = format;
+                pool.submit(group, [p, f] { decode_pixels(*p, f); });
+                ++i;
+                continue;
+            }
+            e.image.reset();
+            e.state.store(LOAD_FAILED, std::memory_order_relaxed);
+        } else if(state == LOAD_DECODED && e.kind == RES_TEXTURE) {
+            if(pages[size_t(e.page)].pixels) {
+                // Nothing in a page can be drawn while it is locked.
+                ++i;
+                continue;
+            }
+            const SDL_Rect dst{e.slot.x, e.slot.y, e.w, e.h};
+            if(!e.staging.empty() &&
+                    SDL_UpdateTexture(pages[size_t(e.page)].tex, &dst, e.staging.data(), e.pitch) != 0) {
+                printf("Could not upload %s: %s\n", e.path.c_str(), SDL_GetError());
+                e.state.store(LOAD_FAILED, std::memory_order_relaxed);
+            }
+            std::vector<Uint8>().swap(e.staging);
+            e.pixels = nullptr;
+            e.bytes = size_t(e.w)*e.h*SDL_BYTESPERPIXEL(format);
+        } else if(state == LOAD_DECODED) {
+            e.bytes = e.chunk ? e.chunk->alen : e.encoded.size();
+        }
+        if(e.state.load(std::memory_order_relaxed) == LOAD_FAILED) {
+            if(e.in_lock) {
+                // Failed after the count above.
+                --pages[size_t(e.page)].filling;
+                e.in_lock = false;
+            }
+            free_texture(e);
+        }
+        if(e.state.load(std::memory_order_relaxed) == LOAD_DECODED) {
+            used[e.kind] += e.bytes;
+            e.last_frame = frame;
+            e.state.store(LOAD_READY, std::memory_order_relaxed);
+        }
+        in_flight[i] = in_flight.back();
+        in_flight.pop_back();
+        if(e.replaces) {
+            finish_reload(e);
+        }
+    }
+    for(size_t i=0; i<retired.size();) {
+        const sound_asset s{retired[i].chunk, encoded_sound{retired[i].encoded.data(), retired[i].encoded.size()}};
+        if(!audio || !audio->uses(s)) {
+            Mix_FreeChunk(retired[i].chunk);
+            retired[i] = std::move(retired.back());
+            retired.pop_back();
+        } else {
+            ++i;
+        }
+    }
+    evict(RES_TEXTURE);
+    evict(RES_SOUND);
+}
+
+bool resource_manager::reload(const char *path) {
+    auto it = entries.find(path);
+    if(it == entries.end()) {
+        return false;
+    }
+    auto &target = *it->second;
+    const int state = target.state.load(std::memory_order_relaxed);
+    if(target.reloading || (state != LOAD_READY && state != LOAD_FAILED)) {
+        // The file may have changed after it was read.
+        target.reload_again = true;
+        return true;
+    }
+    auto fresh = std::make_unique<resource_entry>();
+    fresh->path = target.path;
+    fresh->kind = target.kind;
+    fresh->replaces = &target;
+    target.reloading = true;
+    start_load(*fresh);
+    replacements.push_back(std::move(fresh));
+    return true;
+}
+
+void resource_manager::finish_reload(resource_entry &fresh) {
+    auto &target = *fresh.replaces;
+    target.reloading = false;
+    if(fresh.state.load(std::memory_order_relaxed) == LOAD_READY) {
+        // Textures are not referenced between frames, but the old
+        // sound may still be playing.
+        free_texture(target);
+        if(playing(target)) {
+            retired.push_back(retired_sound{target.chunk, std::move(target.encoded)});
+        } else {
+            Mix_FreeChunk(target.chunk);
+        }
+        used[target.kind] -= target.bytes;
+        target.page = fresh.page;
+        target.slot = fresh.slot;
+        target.w = fresh.w;
+        target.h = fresh.h;
+        target.pitch = fresh.pitch;
+        target.chunk = fresh.chunk;
+        target.encoded = std::move(fresh.encoded);
+        target.bytes = fresh.bytes;
+        target.state.store(LOAD_READY, std::memory_order_relaxed);
+        fresh.page = -1;
+        fresh.chunk = nullptr;
+        printf("Reloaded %s.\n", target.path.c_str());
+    } else {
+        printf("Keeping the old version of %s.\n", target.path.c_str());
+    }
+    const bool again = target.reload_again;
+    target.reload_again = false;
+    for(auto &r : replacements) {
+        if(r.get() == &fresh) {
+            free_texture(*r);
+            free_payload(*r);
+            r = std::move(replacements.back());
+            replacements.pop_back();
+            break;
+        }
+    }
+    if(again) {
+        reload(target.path.c_str());
+    }
+}
+
+void resource_manager::finish() {
+    // Textures need a second round trip through update() once opened.
+    while(!in_flight.empty()) {
+        pool.wait(group);
+        update();
+    }
+}
+
+bool resource_manager::place_texture(resource_entry &e) {
+    e.w = e.image->w;
+    e.h = e.image->h;
+    for(size_t i=0; i<pages.size() && e.page < 0; ++i) {
+        if(pages[i].slots.allocate(e.w, e.h, e.slot)) {
+            e.page = int(i);
+        }
+    }
+    if(e.page < 0) {
+        // New pages stay locked until the images placed in them while
+        // they are filled have all been decoded into the lock.
+        const int ps = std::max({page_size, e.w + 1, e.h + 1});
+        SDL_Texture *tex = SDL_CreateTexture(rend, format, SDL_TEXTUREACCESS_STREAMING, ps, ps);
+        if(!tex) {
+            printf("Could not create atlas page for %s: %s\n", e.path.c_str(), SDL_GetError());
+            return false;
+        }
+        void *pixels;
+        int pitch;
+        if(SDL_LockTexture(tex, nullptr, &pixels, &pitch) != 0) {
+            printf("Could not lock atlas page for %s: %s\n", e.path.c_str(), SDL_GetError());
+            SDL_DestroyTexture(tex);
+            return false;
+        }
+        // Cleared so that padding does not bleed into filtered edges.
+        for(int y=0; y<ps; ++y) {
+            memset(static_cast<Uint8*>(pixels) + size_t(y)*pitch, 0, size_t(ps)*SDL_BYTESPERPIXEL(format));
+        }
+        SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
+        pages.push_back(atlas_page{tex, page_allocator(ps, ps), pixels, pitch, 0});
+        pages.back().slots.allocate(e.w, e.h, e.slot);
+        e.page = int(pages.size() - 1);
+    }
+    auto &p = pages[size_t(e.page)];
+    if(p.pixels) {
+        e.pitch = p.pitch;
+        e.pixels = static_cast<Uint8*>(p.pixels) + size_t(e.slot.y)*p.pitch + size_t(e.slot.x)*SDL_BYTESPERPIXEL(format);
+        e.in_lock = true;
+        ++p.filling;
+    } else {
+        e.pitch = e.w*SDL_BYTESPERPIXEL(format);
+        e.staging.resize(size_t(e.pitch)*e.h);
+        e.pixels = e.staging.data();
+    }
+    return true;
+}
+
+void resource_manager::free_texture(resource_entry &e) {
+    if(e.page >= 0) {
+        pages[size_t(e.page)].slots.release(e.slot);
+        e.page = -1;
+    }
+}
+
+void resource_manager::evict(int kind) {
+    const size_t budget = kind == RES_TEXTURE ? texture_budget : sound_budget;
+    while(used[kind] > budget) {
+        resource_entry *victim = nullptr;
+        for(auto &kv : entries) {
+            auto &e = *kv.second;
+            if(e.kind != kind || e.refs > 0 || e.reloading ||
+                    e.state.load(std::memory_order_relaxed) != LOAD_READY) {
+                continue;
+            }
+            if(kind == RES_SOUND && playing(e)) {
+                continue;
+            }
+            if(!victim || e.last_frame < victim->last_frame) {
+                victim = &e;
+            }
+        }
+        if(!victim) {
+            // Everything that remains is in use.
+            return;
+        }
+        release(*victim);
+    }
+}
+
+// Also collects the sounds that the audio thread has finished with.
+bool resource_manager::playing(const resource_entry &e) const {
+    if(!audio || (!e.chunk && e.encoded.empty())) {
+        return false;
+    }
+    return audio->uses(sound_asset{e.chunk, encoded_sound{e.encoded.data(), e.encoded.size()}});
+}
+
+void resource_manager::release(resource_entry &e) {
+    free_texture(e);
+    free_payload(e);
+    used[e.kind] -= e.bytes;
+    // Nothing refers to the entry, so it can go away entirely.
+    const std::string path = e.path;
+    entries.erase(path);
+}
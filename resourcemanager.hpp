@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include<SDL.h>
+#include<SDL_mixer.h>
+#include"atlas.hpp"
+#include"soundstream.hpp"
+#include"workerpool.hpp"
+#include<memory>
+#include<string>
+#include<unordered_map>
+#include<vector>
+
+const size_t default_texture_budget = size_t(256) << 20;
+const size_t default_sound_budget = size_t(64) << 20;
+
+struct audiocontrol;
+struct pcm_cache;
+struct resource_entry;
+
+// Keeps a resource loaded. Copying adds a reference. Only to be used
+// on the main thread.
+struct resource_handle {
+    resource_handle() = default;
+    explicit resource_handle(resource_entry *e);
+    resource_handle(const resource_handle &o);
+    resource_handle& operator=(const resource_handle &o);
+    ~resource_handle();
+
+    resource_entry *entry = nullptr;
+};
+
+// Loads textures and sounds by path on the worker pool. Until a
+// resource has been loaded it is drawn as a placeholder or plays as
+// silence. Resources without handles stay cached until their kind
+// goes over its memory budget, at which point the least recently used
+// ones are freed. Textures are decoded on the pool in the renderer's
+// preferred format into shared atlas pages, so that the loaded images
+// batch into one draw per page like a prebaked atlas. Images that
+// arrive while a new page is being filled are decoded straight into
+// its locked pixels, later ones into a buffer that is then copied.
+// Sounds are resampled to the mixer's format by load_sound, with
+// conversions kept in the cache if there is one. A sound is only freed
+// once the audio control, if there is one, no longer plays or has
+// queued it.
+struct resource_manager {
+    size_t texture_budget = default_texture_budget;
+    size_t sound_budget = default_sound_budget;
+
+    resource_manager(SDL_Renderer *rend, workerpool &pool, double stream_seconds = stream_min_seconds,
+            const pcm_cache *cache = nullptr, audiocontrol *audio = nullptr);
+    ~resource_manager();
+
+    resource_manager(const resource_manager &) = delete;
+    resource_manager& operator=(const resource_manager &) = delete;
+
+    resource_handle texture(const char *path);
+    resource_handle sound(const char *path);
+
+    bool ready(const resource_handle &h) const;
+    // Both mark the resource as used in this frame.
+    sprite get_sprite(const resource_handle &h);
+    sound_asset get_sound(const resource_handle &h);
+
+    // Loads the file again if it is in use. The old version stays
+    // until the new one is ready and is kept if loading fails.
+    bool reload(const char *path);
+
+    // Once per frame: uploads finished loads, swaps in reloaded
+    // resources and evicts.
+    void update();
+    // Blocks until nothing is loading.
+    void finish();
+
+    size_t texture_bytes() const { return used[0]; }
+    size_t sound_bytes() const { return used[1]; }
+    size_t loading() const { return in_flight.size(); }
+
+private:
+    resource_handle get(const char *path, int kind);
+    void start_load(resource_entry &e);
+    bool place_texture(resource_entry &e);
+    void free_texture(resource_entry &e);
+    void finish_reload(resource_entry &fresh);
+    void evict(int kind);
+    void release(resource_entry &e);
+    bool playing(const resource_entry &e) const;
+
+    SDL_Renderer *rend;
+    workerpool &pool;
+    double stream_seconds;
+    const pcm_cache *cache;
+    audiocontrol *audio;
+    task_group group;
+    SDL_Texture *placeholder;
+    // Images are decoded in this format, which is also the pages'.
+    Uint32 format;
+    int page_size;
+    // A page is locked from its creation until the images placed in
+    // it meanwhile have decoded, others are copied in from staging.
+    struct atlas_page {
+        SDL_Texture *tex;
+        page_allocator slots;
+        void *pixels;
+        int pitch;
+        int filling;
+    };
+    std::vector<atlas_page> pages;
+    std::unordered_map<std::string, std::unique_ptr<resource_entry>> entries;
+    std::vector<resource_entry*> in_flight;
+    std::vector<std::unique_ptr<resource_entry>> replacements;
+    // Sounds that were reloaded while they were still playing.
+    struct retired_sound {
+        Mix_Chunk *chunk;
+        std::vector<Uint8> encoded;
+    };
+    std::vector<retired_sound> retired;
+    size_t used[2] = {0, 0};
+    Uint64 frame = 0;
+};
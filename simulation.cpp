@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#include"simulation.hpp"
+#include<cmath>
+
+sim_pipeline::sim_pipeline(workerpool &pool_, const entity_store &ents_, const motion_params &m,
+        double step_seconds, double cycle_seconds) :
+        pool(pool_), ents(ents_), motion(m), step(step_seconds), cycle(cycle_seconds) {
+    for(auto &l : lists) {
+        l.resize(ents.size());
+    }
+    kick(prev, 0);
+    kick(cur, 0);
+    pool.wait(group);
+    kick(next, 1);
+}
+
+sim_pipeline::~sim_pipeline() {
+    pool.wait(group);
+}
+
+void sim_pipeline::kick(int slot, int64_t step_index) {
+    const float ratio = float(std::fmod(step_index*step, cycle)/cycle);
+    const entity_store *e = &ents;
+    render_list *o = &lists[slot];
+    const motion_params *m = &motion;
+    // The slot's previous tasks have all finished.
+    arenas[slot].reset();
+    pool.parallel_for(group, arenas[slot], 0, ents.size(), chunk_size, [e, o, m, ratio](size_t begin, size_t end) {
+        update_positions(*e, *o, begin, end, ratio, *m);
+    });
+}
+
+void sim_pipeline::advance(double seconds) {
+    accumulator = std::fmin(accumulator + seconds, max_steps*step);
+    const int steps = int(accumulator/step);
+    if(steps == 0) {
+        return;
+    }
+    accumulator -= steps*step;
+    pool.wait(group);
+    step_count += steps;
+    if(steps == 1) {
+        // The precomputed state is the new current one.
+        const int old_prev = prev;
+        prev = cur;
+        cur = next;
+        next = old_prev;
+    } else {
+        kick(prev, step_count - 1);
+        kick(cur, step_count);
+        pool.wait(group);
+    }
+    kick(next, step_count + 1);
+}
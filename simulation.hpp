@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include"entities.hpp"
+#include"framearena.hpp"
+#include"workerpool.hpp"
+#include<cstdint>
+
+// Fixed timestep entity simulation. Time is fed in with advance() and
+// consumed in steps of a fixed length, so simulation cost does not
+// depend on the frame rate. The two most recent states are kept for
+// the renderer to interpolate between.
+//
+// The state after the current one is computed ahead of time on the
+// worker pool, so when the next step is due its result is usually
+// already there and frame N+1 is simulated while frame N renders.
+// Each state has an arena for the tasks that compute it, reset when
+// the state is computed again, so taking a step does not allocate.
+struct sim_pipeline {
+    // Entities are updated in chunks of this many per task.
+    static const size_t chunk_size = 16384;
+    // Time beyond this many steps in one advance() is dropped.
+    static const int max_steps = 8;
+
+    sim_pipeline(workerpool &pool, const entity_store &ents, const motion_params &m,
+            double step_seconds, double cycle_seconds);
+    ~sim_pipeline();
+
+    sim_pipeline(const sim_pipeline &) = delete;
+    sim_pipeline& operator=(const sim_pipeline &) = delete;
+
+    void advance(double seconds);
+
+    const render_list& previous() const { return lists[prev]; }
+    const render_list& current() const { return lists[cur]; }
+    // Number of steps taken so far, current() is the state after it.
+    int64_t steps() const { return step_count; }
+    double seconds_to_next_step() const { return step - accumulator; }
+    // How far between previous and current the present moment is.
+    float alpha() const { return float(accumulator/step); }
+
+private:
+    void kick(int slot, int64_t step_index);
+
+    workerpool &pool;
+    const entity_store &ents;
+    motion_params motion;
+    double step;
+    double cycle;
+    double accumulator = 0;
+    int64_t step_count = 0;
+    render_list lists[3];
+    linear_arena arenas[3];
+    int prev = 0;
+    int cur = 1;
+    int next = 2;
+    task_group group;
+};
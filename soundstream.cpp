@@ -0,0 +1,295 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#include"soundstream.hpp"
+#include<vorbis/vorbisfile.h>
+#include<algorithm>
+#include<chrono>
+#include<cstdio>
+#include<cstring>
+
+namespace {
+
+enum slot_state : int {
+    SLOT_FREE,
+    SLOT_PLAYING,
+    SLOT_RELEASED,
+};
+
+// How much is decoded at a time and how often the rings are topped up.
+const size_t stream_chunk_samples = 4096;
+const auto refill_interval = std::chrono::milliseconds(20);
+
+struct memory_reader {
+    const Uint8 *data;
+    size_t size;
+    size_t pos;
+};
+
+size_t memory_read(void *ptr, size_t size, size_t nmemb, void *src) {
+    auto *r = static_cast<memory_reader*>(src);
+    if(size == 0) {
+        return 0;
+    }
+    const size_t n = std::min(nmemb, (r->size - r->pos)/size);
+    memcpy(ptr, r->data + r->pos, n*size);
+    r->pos += n*size;
+    return n;
+}
+
+int memory_seek(void *src, ogg_int64_t offset, int whence) {
+    auto *r = static_cast<memory_reader*>(src);
+    ogg_int64_t base = 0;
+    if(whence == SEEK_CUR) {
+        base = ogg_int64_t(r->pos);
+    } else if(whence == SEEK_END) {
+        base = ogg_int64_t(r->size);
+    }
+    if(base + offset < 0 || base + offset > ogg_int64_t(r->size)) {
+        return -1;
+    }
+    r->pos = size_t(base + offset);
+    return 0;
+}
+
+long memory_tell(void *src) {
+    return long(static_cast<memory_reader*>(src)->pos);
+}
+
+const ov_callbacks memory_callbacks{memory_read, memory_seek, nullptr, memory_tell};
+
+}
+
+// The slot belongs to the main thread while free, to the decoder and
+// audio threads while playing and to the decoder once released.
+struct stream_slot {
+    std::atomic<int> state{SLOT_FREE};
+    // Set once the decoder has filled the ring for the first time,
+    // before which running out of data is not an underrun.
+    std::atomic<bool> primed{false};
+    // Set once the whole sound has been written to the ring.
+    std::atomic<bool> decoded{false};
+    spsc_ring<Sint16, stream_ring_samples> ring;
+    memory_reader src;
+    OggVorbis_File vf;
+    SDL_AudioStream *conv = nullptr;
+    bool eof = false;
+};
+
+namespace {
+
+void fill_slot(stream_slot &s) {
+    Sint16 pcm[stream_chunk_samples];
+    while(true) {
+        const size_t space = s.ring.space();
+        const int ready = SDL_AudioStreamAvailable(s.conv)/int(sizeof(Sint16));
+        if(ready > 0) {
+            // Converted data goes out first so the conversion queue
+            // never grows past one decoded chunk.
+            const size_t n = std::min({size_t(ready), space, stream_chunk_samples});
+            if(n == 0) {
+                return;
+            }
+            const int got = SDL_AudioStreamGet(s.conv, pcm, int(n*sizeof(Sint16)));
+            if(got <= 0) {
+                return;
+            }
+            s.ring.write(pcm, size_t(got)/sizeof(Sint16));
+            continue;
+        }
+        if(s.eof) {
+            s.decoded.store(true, std::memory_order_release);
+            return;
+        }
+        if(space < stream_chunk_samples) {
+            return;
+        }
+        int section;
+        const long r = ov_read(&s.vf, reinterpret_cast<char*>(pcm), int(sizeof(pcm)),
+                SDL_BYTEORDER == SDL_BIG_ENDIAN, 2, 1, &section);
+        if(r > 0) {
+            SDL_AudioStreamPut(s.conv, pcm, int(r));
+        } else if(r != OV_HOLE) {
+            // End of data or an error that can not be recovered from.
+            SDL_AudioStreamFlush(s.conv);
+            s.eof = true;
+        }
+    }
+}
+
+void close_slot(stream_slot &s) {
+    ov_clear(&s.vf);
+    SDL_FreeAudioStream(s.conv);
+    s.conv = nullptr;
+    s.ring.reset();
+    s.state.store(SLOT_FREE, std::memory_order_release);
+}
+
+}
+
+double vorbis_seconds(const Uint8 *data, size_t size) {
+    memory_reader r{data, size, 0};
+    OggVorbis_File vf;
+    if(ov_open_callbacks(&r, &vf, nullptr, 0, memory_callbacks) != 0) {
+        return -1;
+    }
+    const double seconds = ov_time_total(&vf, -1);
+    ov_clear(&vf);
+    return seconds;
+}
+
+bool decode_vorbis(const Uint8 *data, size_t size, std::vector<Sint16> &pcm, int &rate, int &channels) {
+    memory_reader r{data, size, 0};
+    OggVorbis_File vf;
+    if(ov_open_callbacks(&r, &vf, nullptr, 0, memory_callbacks) != 0) {
+        return false;
+    }
+    const vorbis_info *vi = ov_info(&vf, -1);
+    rate = int(vi->rate);
+    channels = vi->channels;
+    pcm.clear();
+    Sint16 buf[stream_chunk_samples];
+    int section;
+    while(true) {
+        const long got = ov_read(&vf, reinterpret_cast<char*>(buf), int(sizeof(buf)),
+                SDL_BYTEORDER == SDL_BIG_ENDIAN, 2, 1, &section);
+        if(got > 0) {
+            pcm.insert(pcm.end(), buf, buf + size_t(got)/sizeof(Sint16));
+        } else if(got != OV_HOLE) {
+            break;
+        }
+    }
+    ov_clear(&vf);
+    return true;
+}
+
+stream_player::stream_player() : underruns(0), slots(new stream_slot[max_streams]),
+        freq(0), channels(0), stopping(false) {
+}
+
+stream_player::~stream_player() {
+    close();
+}
+
+void stream_player::close() {
+    if(decoder.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            stopping = true;
+        }
+        cv.notify_one();
+        decoder.join();
+    }
+    for(int i=0; i<max_streams; ++i) {
+        if(slots[i].state.load(std::memory_order_acquire) != SLOT_FREE) {
+            close_slot(slots[i]);
+        }
+    }
+    stopping = false;
+}
+
+void stream_player::open(int freq_, int channels_) {
+    freq = freq_;
+    channels = channels_;
+    decoder = std::thread([this] { run(); });
+}
+
+int stream_player::start(const encoded_sound &e) {
+    if(!decoder.joinable()) {
+        return -1;
+    }
+    for(int i=0; i<max_streams; ++i) {
+        auto &s = slots[i];
+        if(s.state.load(std::memory_order_acquire) != SLOT_FREE) {
+            continue;
+        }
+        s.src = memory_reader{e.data, e.size, 0};
+        if(ov_open_callbacks(&s.src, &s.vf, nullptr, 0, memory_callbacks) != 0) {
+            printf("Could not decode streamed sound.\n");
+            return -1;
+        }
+        const vorbis_info *vi = ov_info(&s.vf, -1);
+        s.conv = SDL_NewAudioStream(AUDIO_S16SYS, Uint8(vi->channels), int(vi->rate),
+                AUDIO_S16SYS, Uint8(channels), freq);
+        if(!s.conv) {
+            printf("Could not create audio stream: %s\n", SDL_GetError());
+            ov_clear(&s.vf);
+            return -1;
+        }
+        s.eof = false;
+        s.primed.store(false, std::memory_order_relaxed);
+        s.decoded.store(false, std::memory_order_relaxed);
+        {
+            // Under the lock so the decoder can not miss the wakeup.
+            std::lock_guard<std::mutex> lock(m);
+            s.state.store(SLOT_PLAYING, std::memory_order_release);
+        }
+        cv.notify_one();
+        return i;
+    }
+    return -1;
+}
+
+bool stream_player::active() const {
+    for(int i=0; i<max_streams; ++i) {
+        if(slots[i].state.load(std::memory_order_acquire) != SLOT_FREE) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool stream_player::uses(const Uint8 *data) const {
+    for(int i=0; i<max_streams; ++i) {
+        // The source is only written by the main thread, while free.
+        if(slots[i].state.load(std::memory_order_acquire) != SLOT_FREE && slots[i].src.data == data) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int stream_player::read(int slot, Sint16 *out, int samples) {
+    auto &s = slots[slot];
+    const int n = int(s.ring.read(out, size_t(samples)));
+    if(n < samples && s.primed.load(std::memory_order_acquire) && !s.decoded.load(std::memory_order_acquire)) {
+        underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+    return n;
+}
+
+bool stream_player::finished(int slot) const {
+    const auto &s = slots[slot];
+    return s.decoded.load(std::memory_order_acquire) && s.ring.empty();
+}
+
+void stream_player::release(int slot) {
+    slots[slot].state.store(SLOT_RELEASED, std::memory_order_release);
+}
+
+void stream_player::run() {
+    std::unique_lock<std::mutex> lock(m);
+    while(!stopping) {
+        bool active = false;
+        for(int i=0; i<max_streams; ++i) {
+            auto &s = slots[i];
+            const int state = s.state.load(std::memory_order_acquire);
+            if(state == SLOT_PLAYING) {
+                lock.unlock();
+                fill_slot(s);
+                s.primed.store(true, std::memory_order_release);
+                lock.lock();
+                active = true;
+            } else if(state == SLOT_RELEASED) {
+                close_slot(s);
+            }
+        }
+        // Released slots are only noticed here, which is fine since a
+        // slot can only be released while it was active.
+        if(active) {
+            cv.wait_for(lock, refill_interval);
+        } else {
+            cv.wait(lock);
+        }
+    }
+}
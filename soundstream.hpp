@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include<SDL.h>
+#include<SDL_mixer.h>
+#include"spsc.hpp"
+#include<atomic>
+#include<condition_variable>
+#include<memory>
+#include<mutex>
+#include<thread>
+#include<vector>
+
+// Sounds at least this long are decoded while they play instead of
+// at load time.
+const double stream_min_seconds = 10.0;
+const int max_streams = 2;
+// About a third of a second of 44.1 kHz stereo.
+const size_t stream_ring_samples = 1 << 15;
+
+// Compressed Ogg Vorbis data. Not owned.
+struct encoded_sound {
+    const Uint8 *data;
+    size_t size;
+};
+
+// A sound is either fully decoded or streamed from its encoded data.
+struct sound_asset {
+    Mix_Chunk *chunk;
+    encoded_sound encoded;
+};
+
+// Length of Ogg Vorbis data in seconds, negative if it is not Vorbis.
+double vorbis_seconds(const Uint8 *data, size_t size);
+// Decodes all of it to interleaved native 16 bit samples at the
+// stream's own rate. Returns false if it is not Vorbis.
+bool decode_vorbis(const Uint8 *data, size_t size, std::vector<Sint16> &pcm, int &rate, int &channels);
+
+struct stream_slot;
+
+// Decodes streamed sounds on a thread of its own into rings that the
+// audio thread reads from. Like the voice queue, the audio side never
+// blocks or allocates.
+struct stream_player {
+    stream_player();
+    ~stream_player();
+
+    stream_player(const stream_player &) = delete;
+    stream_player& operator=(const stream_player &) = delete;
+
+    // Sets the output format, which is always signed 16 bit, and
+    // starts the decoder thread.
+    void open(int freq, int channels);
+    // Stops the decoder thread and frees every slot, after which
+    // nothing refers to the encoded data any more. The audio thread
+    // must no longer be reading.
+    void close();
+
+    // Main thread. Opens the data in a free slot and returns its index,
+    // or -1 if none is free or the data can not be decoded. The decoder
+    // thread does the first fill, so the sound starts once it has.
+    int start(const encoded_sound &s);
+
+    // Main thread. Whether any slot is in use, or reads the given data.
+    bool active() const;
+    bool uses(const Uint8 *data) const;
+
+    // Audio thread. Returns how many samples were available.
+    int read(int slot, Sint16 *out, int samples);
+    // Audio thread. Whether everything has been read.
+    bool finished(int slot) const;
+    // Audio thread. Hands the slot back for reuse.
+    void release(int slot);
+
+    std::atomic<int> underruns;
+
+private:
+    void run();
+
+    std::unique_ptr<stream_slot[]> slots;
+    int freq;
+    int channels;
+    std::thread decoder;
+    std::mutex m;
+    std::condition_variable cv;
+    bool stopping;
+};
@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#include"spritebatch.hpp"
+#include<cassert>
+
+spritebatch::bucket& spritebatch::find_bucket(SDL_Texture *tex) {
+    bucket *found = nullptr;
+    for(auto &b : buckets) {
+        if(b.tex == tex) {
+            found = &b;
+            break;
+        }
+    }
+    if(found && !found->verts.empty()) {
+        return *found;
+    }
+    if(!found) {
+        buckets.push_back(bucket{tex, 0, 0, {}});
+        if(!spare.empty()) {
+            buckets.back().verts.swap(spare.back());
+            spare.pop_back();
+        }
+        found = &buckets.back();
+    }
+    // Asked again on the first quad of every frame. A texture that was
+    // destroyed and recreated may have the same address and a new size.
+    int w, h;
+    auto rc = SDL_QueryTexture(tex, nullptr, nullptr, &w, &h);
+    assert(!rc);
+    found->inv_w = 1.0f/w;
+    found->inv_h = 1.0f/h;
+    return *found;
+}
+
+void spritebatch::ensure_indices(size_t quads) {
+    const size_t old_quads = indices.size()/6;
+    if(old_quads >= quads) {
+        return;
+    }
+    indices.reserve(quads*6);
+    for(size_t i=old_quads; i<quads; ++i) {
+        const int base = int(4*i);
+        indices.push_back(base);
+        indices.push_back(base + 1);
+        indices.push_back(base + 2);
+        indices.push_back(base + 2);
+        indices.push_back(base + 3);
+        indices.push_back(base);
+    }
+}
+
+void spritebatch::add(SDL_Texture *tex, const SDL_Rect *src, const SDL_Rect &dst) {
+    add(tex, src, SDL_FRect{float(dst.x), float(dst.y), float(dst.w), float(dst.h)});
+}
+
+void spritebatch::add(SDL_Texture *tex, const SDL_Rect *src, const SDL_FRect &dst) {
+    auto &b = find_bucket(tex);
+    float u0 = 0.0f, v0 = 0.0f, u1 = 1.0f, v1 = 1.0f;
+    if(src) {
+        u0 = src->x*b.inv_w;
+        v0 = src->y*b.inv_h;
+        u1 = (src->x + src->w)*b.inv_w;
+        v1 = (src->y + src->h)*b.inv_h;
+    }
+    const float x0 = dst.x;
+    const float y0 = dst.y;
+    const float x1 = dst.x + dst.w;
+    const float y1 = dst.y + dst.h;
+    const SDL_Color white{255, 255, 255, 255};
+    b.verts.push_back(SDL_Vertex{{x0, y0}, white, {u0, v0}});
+    b.verts.push_back(SDL_Vertex{{x1, y0}, white, {u1, v0}});
+    b.verts.push_back(SDL_Vertex{{x1, y1}, white, {u1, v1}});
+    b.verts.push_back(SDL_Vertex{{x0, y1}, white, {u0, v1}});
+}
+
+void spritebatch::flush(SDL_Renderer *rend) {
+    size_t kept = 0;
+    for(size_t i=0; i<buckets.size(); ++i) {
+        auto &b = buckets[i];
+        if(b.verts.empty()) {
+            spare.push_back(std::move(b.verts));
+            continue;
+        }
+        const size_t quads = b.verts.size()/4;
+        ensure_indices(quads);
+        auto rc = SDL_RenderGeometry(rend, b.tex, b.verts.data(), int(b.verts.size()),
+                indices.data(), int(quads*6));
+        assert(!rc);
+        b.verts.clear();
+        if(kept != i) {
+            buckets[kept] = std::move(b);
+        }
+        ++kept;
+    }
+    buckets.erase(buckets.begin() + kept, buckets.end());
+}
+
+size_t spritebatch::num_quads() const {
+    size_t total = 0;
+    for(const auto &b : buckets) {
+        total += b.verts.size()/4;
+    }
+    return total;
+}
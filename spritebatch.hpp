@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include<SDL.h>
+#include<vector>
+
+// Collects textured quads per texture and submits each texture's
+// quads with a single SDL_RenderGeometry call.
+struct spritebatch {
+    struct bucket {
+        SDL_Texture *tex;
+        float inv_w;
+        float inv_h;
+        std::vector<SDL_Vertex> verts;
+    };
+
+    // Buckets and their storage are kept between frames so that
+    // steady state drawing does not allocate. A bucket that gets no
+    // quads between two flushes is dropped, since its texture may be
+    // gone, and its storage goes to spare.
+    std::vector<bucket> buckets;
+    std::vector<std::vector<SDL_Vertex>> spare;
+    std::vector<int> indices;
+
+    void add(SDL_Texture *tex, const SDL_Rect *src, const SDL_Rect &dst);
+    void add(SDL_Texture *tex, const SDL_Rect *src, const SDL_FRect &dst);
+    void flush(SDL_Renderer *rend);
+    size_t num_quads() const;
+
+private:
+    bucket& find_bucket(SDL_Texture *tex);
+    void ensure_indices(size_t quads);
+};
@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include<atomic>
+#include<algorithm>
+#include<cstddef>
+
+// Bounded single producer, single consumer queue. Neither side ever
+// blocks or allocates, which makes it usable from the audio callback.
+template<typename T, size_t N>
+struct spsc_queue {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "Queue size must be a power of two.");
+
+    // Producer side. Returns false if the queue is full.
+    bool push(const T &item) {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if(t - head.load(std::memory_order_acquire) == N) {
+            return false;
+        }
+        items[t & (N - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false if the queue is empty.
+    bool pop(T &item) {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if(h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = items[h & (N - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    T items[N];
+};
+
+// Single producer, single consumer ring of plain values that are
+// written and read in bulk, such as PCM samples.
+template<typename T, size_t N>
+struct spsc_ring {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "Ring size must be a power of two.");
+
+    // Producer side. Returns how many items fit.
+    size_t write(const T *items, size_t count) {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        const size_t n = std::min(count, N - (t - head.load(std::memory_order_acquire)));
+        for(size_t i=0; i<n; ++i) {
+            buf[(t + i) & (N - 1)] = items[i];
+        }
+        tail.store(t + n, std::memory_order_release);
+        return n;
+    }
+
+    // Consumer side. Returns how many items were available.
+    size_t read(T *items, size_t count) {
+        const size_t h = head.load(std::memory_order_relaxed);
+        const size_t n = std::min(count, tail.load(std::memory_order_acquire) - h);
+        for(size_t i=0; i<n; ++i) {
+            items[i] = buf[(h + i) & (N - 1)];
+        }
+        head.store(h + n, std::memory_order_release);
+        return n;
+    }
+
+    // Only exact on the producer side.
+    size_t space() const {
+        return N - (tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire));
+    }
+
+    // Only exact on the consumer side.
+    bool empty() const {
+        return head.load(std::memory_order_relaxed) == tail.load(std::memory_order_acquire);
+    }
+
+    // Neither side may be active.
+    void reset() {
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    T buf[N];
+};
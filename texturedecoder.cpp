@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#include"texturedecoder.hpp"
+#include"loader.hpp"
+#include<SDL_image.h>
+#include<png.h>
+#include<cstdio>
+#include<cstring>
+
+struct png_state {
+    png_image image;
+};
+
+namespace {
+
+// The libpng output layout that matches an SDL format byte for byte,
+// or zero if there is none.
+Uint32 png_format_for(Uint32 format) {
+    switch(format) {
+    case SDL_PIXELFORMAT_RGBA32:
+        return PNG_FORMAT_RGBA;
+    case SDL_PIXELFORMAT_BGRA32:
+        return PNG_FORMAT_BGRA;
+    case SDL_PIXELFORMAT_ARGB32:
+        return PNG_FORMAT_ARGB;
+    case SDL_PIXELFORMAT_ABGR32:
+        return PNG_FORMAT_ABGR;
+    default:
+        return 0;
+    }
+}
+
+}
+
+Uint32 preferred_texture_format(SDL_Renderer *rend) {
+    SDL_RendererInfo info;
+    if(SDL_GetRendererInfo(rend, &info) == 0) {
+        for(Uint32 i=0; i<info.num_texture_formats; ++i) {
+            const Uint32 f = info.texture_formats[i];
+            if(!SDL_ISPIXELFORMAT_FOURCC(f) && SDL_ISPIXELFORMAT_ALPHA(f)) {
+                return f;
+            }
+        }
+    }
+    return SDL_PIXELFORMAT_ARGB8888;
+}
+
+texture_decoder::texture_decoder() = default;
+
+texture_decoder::~texture_decoder() {
+    if(png) {
+        png_image_free(&png->image);
+    }
+    SDL_FreeSurface(surface);
+}
+
+bool texture_decoder::open(const char *fname) {
+    if(!try_read_file(fname, bytes)) {
+        return false;
+    }
+    if(bytes.size() >= 8 && png_sig_cmp(bytes.data(), 0, 8) == 0) {
+        png = std::make_unique<png_state>();
+        memset(&png->image, 0, sizeof(png->image));
+        png->image.version = PNG_IMAGE_VERSION;
+        if(!png_image_begin_read_from_memory(&png->image, bytes.data(), bytes.size())) {
+            printf("Could not read %s: %s\n", fname, png->image.message);
+            return false;
+        }
+        w = int(png->image.width);
+        h = int(png->image.height);
+        return true;
+    }
+    surface = IMG_Load_RW(SDL_RWFromConstMem(bytes.data(), int(bytes.size())), 1);
+    std::vector<Uint8>().swap(bytes);
+    if(!surface) {
+        printf("IMG_Load %s: %s\n", fname, IMG_GetError());
+        return false;
+    }
+    w = surface->w;
+    h = surface->h;
+    return true;
+}
+
+bool texture_decoder::decode(void *pixels, int pitch, Uint32 format) {
+    if(surface) {
+        const bool ok = SDL_ConvertPixels(w, h, surface->format->format, surface->pixels, surface->pitch,
+                format, pixels, pitch) == 0;
+        SDL_FreeSurface(surface);
+        surface = nullptr;
+        return ok;
+    }
+    auto &image = png->image;
+    const Uint32 direct = png_format_for(format);
+    bool ok;
+    if(direct != 0) {
+        image.format = direct;
+        ok = png_image_finish_read(&image, nullptr, pixels, pitch, nullptr);
+    } else {
+        // Still one pass over the pixels of the texture, only it is
+        // converted from a temporary buffer.
+        image.format = PNG_FORMAT_RGBA;
+        std::vector<Uint8> rgba(size_t(w)*h*4);
+        ok = png_image_finish_read(&image, nullptr, rgba.data(), w*4, nullptr) &&
+                SDL_ConvertPixels(w, h, SDL_PIXELFORMAT_RGBA32, rgba.data(), w*4, format, pixels, pitch) == 0;
+    }
+    if(!ok) {
+        printf("PNG decoding failed: %s\n", image.message);
+    }
+    // The simplified API frees its state when reading finishes.
+    png.reset();
+    std::vector<Uint8>().swap(bytes);
+    return ok;
+}
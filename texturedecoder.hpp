@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include<SDL.h>
+#include<memory>
+#include<vector>
+
+// The first format with an alpha channel the renderer lists, which is
+// the one it can upload without converting.
+Uint32 preferred_texture_format(SDL_Renderer *rend);
+
+struct png_state;
+
+// Decodes an image straight into a pixel buffer of the given format.
+// Opening reads only the header, so that room for the image can be
+// made on the render thread before the pixels are decoded. PNG
+// files are decoded by libpng directly in the texture's format, other
+// formats go through SDL_image and a single conversion into the
+// buffer, which may be locked texture memory.
+// Both steps may run on any thread.
+struct texture_decoder {
+    int w = 0;
+    int h = 0;
+
+    texture_decoder();
+    ~texture_decoder();
+
+    texture_decoder(const texture_decoder &) = delete;
+    texture_decoder& operator=(const texture_decoder &) = delete;
+
+    // Prints the reason and returns false on failure.
+    bool open(const char *fname);
+    bool decode(void *pixels, int pitch, Uint32 format);
+
+private:
+    std::vector<Uint8> bytes;
+    std::unique_ptr<png_state> png;
+    SDL_Surface *surface = nullptr;
+};
@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#include"visibility.hpp"
+#include<algorithm>
+#include<cmath>
+
+namespace {
+
+// Cells start at a few sprites across. Sprites that spread over a huge
+// area get bigger cells so that the grid stays small.
+const float min_cell_sprites = 2;
+const int max_grid_cells = 64*64;
+
+}
+
+visibility_stage::visibility_stage(int view_w_, int view_h_, int sprite_w_, int sprite_h_) :
+        view_w(view_w_), view_h(view_h_), sprite_w(sprite_w_), sprite_h(sprite_h_),
+        origin_x(0), origin_y(0), cell_size(1), cols(0), rows(0) {
+}
+
+void visibility_stage::update(const entity_store &scene, const std::vector<sprite> &sprites,
+        const render_list &prev, const render_list &cur, float alpha) {
+    const size_t n = scene.size();
+    xs.resize(n);
+    ys.resize(n);
+    for(size_t i=0; i<n; ++i) {
+        xs[i] = prev.x[i] + alpha*(cur.x[i] - prev.x[i]);
+        ys[i] = prev.y[i] + alpha*(cur.y[i] - prev.y[i]);
+    }
+    bin(n);
+    mark_visible();
+
+    // Texture ranks in order of first use, which is also the order the
+    // batch creates its buckets in.
+    textures.clear();
+    keys.resize(n);
+    int max_key = 0;
+    for(size_t i=0; i<n; ++i) {
+        if(!is_visible[i]) {
+            continue;
+        }
+        SDL_Texture *tex = sprites[scene.sprite_id[i]].tex;
+        const auto it = std::find(textures.begin(), textures.end(), tex);
+        const int rank = int(it - textures.begin());
+        if(it == textures.end()) {
+            textures.push_back(tex);
+        }
+        const int layer = std::min(std::max(scene.layer[i], 0), max_layers - 1);
+        keys[i] = layer*int(sprites.size()) + rank;
+        max_key = std::max(max_key, keys[i]);
+    }
+
+    // Counting sort, which is stable.
+    key_start.assign(size_t(max_key) + 2, 0);
+    size_t count = 0;
+    for(size_t i=0; i<n; ++i) {
+        if(is_visible[i]) {
+            ++key_start[size_t(keys[i]) + 1];
+            ++count;
+        }
+    }
+    for(size_t k=1; k<key_start.size(); ++k) {
+        key_start[k] += key_start[k - 1];
+    }
+    visible.resize(count);
+    for(size_t i=0; i<n; ++i) {
+        if(is_visible[i]) {
+            visible[size_t(key_start[size_t(keys[i])]++)] = visible_sprite{int(i), xs[i], ys[i]};
+        }
+    }
+    culled = n - count;
+}
+
+void visibility_stage::bin(size_t n) {
+    float min_x = 0, min_y = 0, max_x = 0, max_y = 0;
+    if(n > 0) {
+        min_x = max_x = xs[0];
+        min_y = max_y = ys[0];
+    }
+    for(size_t i=1; i<n; ++i) {
+        min_x = std::min(min_x, xs[i]);
+        max_x = std::max(max_x, xs[i]);
+        min_y = std::min(min_y, ys[i]);
+        max_y = std::max(max_y, ys[i]);
+    }
+    // Cells hold sprites by their top left corner.
+    origin_x = min_x;
+    origin_y = min_y;
+    const float span_x = max_x - min_x + 1;
+    const float span_y = max_y - min_y + 1;
+    cell_size = min_cell_sprites*float(std::max(sprite_w, sprite_h));
+    cell_size = std::max(cell_size, std::sqrt(span_x*span_y/max_grid_cells));
+    cols = std::min(int(std::ceil(span_x/cell_size)), max_grid_cells);
+    rows = std::min(int(std::ceil(span_y/cell_size)), max_grid_cells/cols);
+
+    entity_cell.resize(n);
+    cell_start.assign(size_t(cols)*rows + 1, 0);
+    for(size_t i=0; i<n; ++i) {
+        const int cx = std::min(int((xs[i] - origin_x)/cell_size), cols - 1);
+        const int cy = std::min(int((ys[i] - origin_y)/cell_size), rows - 1);
+        entity_cell[i] = cy*cols + cx;
+        ++cell_start[size_t(entity_cell[i]) + 1];
+    }
+    for(size_t c=1; c<cell_start.size(); ++c) {
+        cell_start[c] += cell_start[c - 1];
+    }
+    cell_entities.resize(n);
+    // Fills each cell from its end, in scene order, which leaves the
+    // start of cell c in cell_start[c + 1].
+    for(size_t i=n; i>0; --i) {
+        const int c = entity_cell[i - 1];
+        cell_entities[size_t(--cell_start[size_t(c) + 1])] = int(i - 1);
+    }
+    for(size_t c=0; c+1<cell_start.size(); ++c) {
+        cell_start[c] = cell_start[c + 1];
+    }
+    cell_start.back() = int(n);
+}
+
+void visibility_stage::mark_visible() {
+    is_visible.assign(xs.size(), 0);
+    if(xs.empty()) {
+        return;
+    }
+    // A sprite overlaps the viewport if its corner is in
+    // (-sprite_w, view_w) x (-sprite_h, view_h).
+    const float x0 = -float(sprite_w);
+    const float y0 = -float(sprite_h);
+    const float x1 = float(view_w);
+    const float y1 = float(view_h);
+    const int c0 = std::max(int(std::floor((x0 - origin_x)/cell_size)), 0);
+    const int c1 = std::min(int(std::floor((x1 - origin_x)/cell_size)), cols - 1);
+    const int r0 = std::max(int(std::floor((y0 - origin_y)/cell_size)), 0);
+    const int r1 = std::min(int(std::floor((y1 - origin_y)/cell_size)), rows - 1);
+    for(int r=r0; r<=r1; ++r) {
+        for(int c=c0; c<=c1; ++c) {
+            const int cell = r*cols + c;
+            const float cell_x = origin_x + c*cell_size;
+            const float cell_y = origin_y + r*cell_size;
+            // Cells well inside need no per sprite test.
+            const bool inside = c < cols - 1 && r < rows - 1 &&
+                cell_x > x0 && cell_y > y0 && cell_x + cell_size < x1 && cell_y + cell_size < y1;
+            for(int k=cell_start[size_t(cell)]; k<cell_start[size_t(cell) + 1]; ++k) {
+                const int e = cell_entities[size_t(k)];
+                if(inside || (xs[size_t(e)] > x0 && xs[size_t(e)] < x1 && ys[size_t(e)] > y0 && ys[size_t(e)] < y1)) {
+                    is_visible[size_t(e)] = 1;
+                }
+            }
+        }
+    }
+}
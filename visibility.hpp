@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include"atlas.hpp"
+#include"entities.hpp"
+#include<cstdint>
+#include<vector>
+
+// Layers above this are drawn as the topmost one.
+const int max_layers = 16;
+
+struct visible_sprite {
+    int entity;
+    float x;
+    float y;
+};
+
+// Runs between the simulation and the renderer. Bins the interpolated
+// sprites into a uniform grid over their bounds, keeps those in the
+// cells that overlap the viewport and orders them by layer and, within
+// a layer, by texture, so that the batch needs one draw per texture
+// and layer. Sprites of one texture and layer keep their scene order.
+// All storage is reused between frames.
+struct visibility_stage {
+    visibility_stage(int view_w, int view_h, int sprite_w, int sprite_h);
+
+    void update(const entity_store &scene, const std::vector<sprite> &sprites,
+            const render_list &prev, const render_list &cur, float alpha);
+
+    // In drawing order. Draws must be flushed whenever the layer changes.
+    std::vector<visible_sprite> visible;
+    size_t culled = 0;
+
+private:
+    void bin(size_t n);
+    void mark_visible();
+
+    int view_w;
+    int view_h;
+    int sprite_w;
+    int sprite_h;
+
+    // Interpolated positions of every entity.
+    std::vector<float> xs;
+    std::vector<float> ys;
+    // The grid, with cell_start indexing cell_entities like CSR.
+    float origin_x;
+    float origin_y;
+    float cell_size;
+    int cols;
+    int rows;
+    std::vector<int> entity_cell;
+    std::vector<int> cell_start;
+    std::vector<int> cell_entities;
+    std::vector<uint8_t> is_visible;
+    // Sort scratch.
+    std::vector<int> keys;
+    std::vector<int> key_start;
+    std::vector<SDL_Texture*> textures;
+};
@@ -0,0 +1,177 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#include"workerpool.hpp"
+
+namespace {
+
+// Index of the worker running on this thread, or -1 for other threads.
+thread_local int current_worker = -1;
+
+}
+
+void workerpool::task_ring::push_back(task t) {
+    if(count == slots.size()) {
+        std::vector<task> bigger(slots.empty() ? 16 : 2*slots.size());
+        for(size_t i=0; i<count; ++i) {
+            bigger[i] = std::move(slots[(head + i) % slots.size()]);
+        }
+        slots.swap(bigger);
+        head = 0;
+    }
+    slots[(head + count) % slots.size()] = std::move(t);
+    ++count;
+}
+
+workerpool::task workerpool::task_ring::pop_back() {
+    --count;
+    return std::move(slots[(head + count) % slots.size()]);
+}
+
+workerpool::task workerpool::task_ring::pop_front() {
+    task t = std::move(slots[head]);
+    head = (head + 1) % slots.size();
+    --count;
+    return t;
+}
+
+bool workerpool::task_ring::take(const task_group *g, task &t) {
+    for(size_t i=count; i>0; --i) {
+        if(slots[(head + i - 1) % slots.size()].group != g) {
+            continue;
+        }
+        t = std::move(slots[(head + i - 1) % slots.size()]);
+        for(size_t j=i; j<count; ++j) {
+            slots[(head + j - 1) % slots.size()] = std::move(slots[(head + j) % slots.size()]);
+        }
+        --count;
+        return true;
+    }
+    return false;
+}
+
+workerpool::workerpool(size_t num_threads) {
+    if(num_threads == 0) {
+        const size_t hw = std::thread::hardware_concurrency();
+        num_threads = hw > 1 ? hw - 1 : 1;
+    }
+    for(size_t i=0; i<num_threads; ++i) {
+        queues.push_back(std::make_unique<queue>());
+    }
+    threads.reserve(num_threads);
+    for(size_t i=0; i<num_threads; ++i) {
+        threads.emplace_back([this, i] { run(i); });
+    }
+}
+
+workerpool::~workerpool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> l(sleep_m);
+        stopping = true;
+    }
+    work_available.notify_all();
+    for(auto &t : threads) {
+        t.join();
+    }
+}
+
+void workerpool::submit(std::function<void()> fn) {
+    submit(default_group, std::move(fn));
+}
+
+void workerpool::submit(task_group &g, std::function<void()> fn) {
+    g.pending.fetch_add(1, std::memory_order_relaxed);
+    const size_t target = current_worker >= 0 ?
+            size_t(current_worker) :
+            next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    {
+        std::lock_guard<std::mutex> l(queues[target]->m);
+        queues[target]->tasks.push_back(task{std::move(fn), &g});
+    }
+    queued.fetch_add(1, std::memory_order_release);
+    // Taking the lock orders this with a worker checking queued
+    // before it goes to sleep, so the wakeup can not be lost.
+    { std::lock_guard<std::mutex> l(sleep_m); }
+    work_available.notify_one();
+}
+
+bool workerpool::pop_local(size_t index, task &t) {
+    auto &q = *queues[index];
+    std::lock_guard<std::mutex> l(q.m);
+    if(q.tasks.empty()) {
+        return false;
+    }
+    t = q.tasks.pop_back();
+    return true;
+}
+
+bool workerpool::steal(size_t thief, task &t) {
+    for(size_t i=1; i<=queues.size(); ++i) {
+        auto &q = *queues[(thief + i) % queues.size()];
+        std::lock_guard<std::mutex> l(q.m);
+        if(!q.tasks.empty()) {
+            t = q.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool workerpool::take_from_group(size_t home, const task_group &g, task &t) {
+    for(size_t i=0; i<queues.size(); ++i) {
+        auto &q = *queues[(home + i) % queues.size()];
+        std::lock_guard<std::mutex> l(q.m);
+        if(q.tasks.take(&g, t)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void workerpool::run_task(task &t) {
+    queued.fetch_sub(1, std::memory_order_relaxed);
+    t.fn();
+    t.group->pending.fetch_sub(1, std::memory_order_release);
+}
+
+bool workerpool::try_run_one(size_t home) {
+    task t;
+    if(!pop_local(home, t) && !steal(home, t)) {
+        return false;
+    }
+    run_task(t);
+    return true;
+}
+
+void workerpool::wait() {
+    wait(default_group);
+}
+
+void workerpool::wait(task_group &g) {
+    const size_t home = current_worker >= 0 ? size_t(current_worker) : 0;
+    while(g.pending.load(std::memory_order_acquire) > 0) {
+        task t;
+        if(take_from_group(home, g, t)) {
+            run_task(t);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void workerpool::run(size_t index) {
+    current_worker = int(index);
+    while(true) {
+        if(try_run_one(index)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> l(sleep_m);
+        work_available.wait(l, [this] {
+            return stopping || queued.load(std::memory_order_acquire) > 0;
+        });
+        if(stopping && queued.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2019-2024 Jussi Pakkanen.
+
+#pragma once
+
+#include"framearena.hpp"
+#include<atomic>
+#include<condition_variable>
+#include<functional>
+#include<memory>
+#include<mutex>
+#include<thread>
+#include<vector>
+
+// A set of tasks that can be waited on independently of the rest.
+struct task_group {
+    std::atomic<size_t> pending{0};
+};
+
+// Work stealing thread pool. Every worker has its own queue. Workers
+// take their own newest task first and steal the oldest task from
+// another worker when their queue is empty. Tasks submitted from a
+// worker go to that worker's queue.
+struct workerpool {
+    // Zero means one thread per hardware thread, minus one for the
+    // main thread.
+    explicit workerpool(size_t num_threads = 0);
+    ~workerpool();
+
+    workerpool(const workerpool &) = delete;
+    workerpool& operator=(const workerpool &) = delete;
+
+    void submit(std::function<void()> task);
+    void submit(task_group &g, std::function<void()> task);
+    // Blocks until every task submitted without a group has finished.
+    void wait();
+    // Blocks until the group is done. The caller runs the group's
+    // queued tasks while it waits, but nothing else, so that waiting
+    // on short tasks never gets stuck behind a long one.
+    void wait(task_group &g);
+
+    // Calls f(chunk_begin, chunk_end) for consecutive chunks of
+    // [begin, end) as separate tasks of the group.
+    template<typename F>
+    void parallel_for(task_group &g, size_t begin, size_t end, size_t chunk, F f) {
+        for(size_t b=begin; b<end; b+=chunk) {
+            const size_t e = end - b > chunk ? b + chunk : end;
+            submit(g, [f, b, e] { f(b, e); });
+        }
+    }
+
+    // The same, but the chunk tasks live in the arena, so that nothing
+    // is allocated per task. The arena must not be reset before the
+    // group is done.
+    template<typename F>
+    void parallel_for(task_group &g, linear_arena &arena, size_t begin, size_t end, size_t chunk, F f) {
+        struct job {
+            F f;
+            size_t begin;
+            size_t end;
+        };
+        for(size_t b=begin; b<end; b+=chunk) {
+            const size_t e = end - b > chunk ? b + chunk : end;
+            const job *j = arena.create<job>(job{f, b, e});
+            // A single pointer fits in std::function without allocating.
+            submit(g, [j] { j->f(j->begin, j->end); });
+        }
+    }
+
+    size_t size() const { return threads.size(); }
+
+private:
+    struct task {
+        std::function<void()> fn;
+        task_group *group;
+    };
+
+    // Double ended queue that keeps its storage. std::deque frees and
+    // reallocates blocks as tasks come and go.
+    struct task_ring {
+        std::vector<task> slots;
+        size_t head = 0;
+        size_t count = 0;
+
+        bool empty() const { return count == 0; }
+        void push_back(task t);
+        task pop_back();
+        task pop_front();
+        // Removes the newest task of the group.
+        bool take(const task_group *g, task &t);
+    };
+
+    struct queue {
+        std::mutex m;
+        task_ring tasks;
+    };
+
+    void run(size_t index);
+    bool try_run_one(size_t home);
+    bool pop_local(size_t index, task &t);
+    bool steal(size_t thief, task &t);
+    bool take_from_group(size_t home, const task_group &g, task &t);
+    void run_task(task &t);
+
+    std::vector<std::unique_ptr<queue>> queues;
+    std::vector<std::thread> threads;
+    task_group default_group;
+    std::atomic<size_t> queued{0};
+    std::atomic<size_t> next_queue{0};
+    std::mutex sleep_m;
+    std::condition_variable work_available;
+    bool stopping = false;
+};